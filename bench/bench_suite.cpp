@@ -0,0 +1,475 @@
+// Benchmark suite: microbenchmarks of the CPU core, memory, snapshots and frame
+// conversion, plus headless ROM runs with scripted input. Results are written as
+// JSON and compared against a stored baseline; every value is a time, lower is better.
+// Each benchmark reports its fastest run, and how far behind the next fastest runs were.
+// The comparison is relative to a fixed host workload measured in the same run, so that
+// a baseline recorded on a faster or slower machine does not read as a change, and each
+// benchmark is allowed its measured spread on top of the threshold, plus a margin that grows
+// with how far that scaling had to move. Regressions are measured a second time before they count.
+// Usage: bench_suite invaders.h invaders.g invaders.f invaders.e
+//            [--json file] [--baseline file] [--threshold percent]
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <string>
+#include <vector>
+#include "../src/cpu.h"
+#include "../src/display_filter.h"
+
+static const int REPETITIONS = 11; // Rounds over every benchmark; each reports its fastest run, the least disturbed by the host
+static const int SPREAD_RANK = 2; // The spread is how much slower the third fastest run was than the fastest
+static const char* const CALIBRATION = "reference/calibration"; // Host workload the comparison is scaled by
+static const double HOST_DRIFT_WEIGHT = 3; // Tolerance points added per point the calibration moved from the baseline
+volatile uint32_t sink; // Keeps computed values alive
+
+struct Benchmark {
+    std::string name;
+    std::string unit;
+    std::function<double()> run; // One timed run, returns its time per operation
+};
+
+struct Result {
+    std::string name;
+    double value; // Fastest run
+    std::string unit;
+    double spread; // Percent, see SPREAD_RANK: how closely the other runs reproduced the fastest
+};
+
+static double Seconds(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+// Every benchmark once per round, for REPETITIONS rounds, keeping each one's fastest run: a
+// slow spell of the host spoils one round instead of every run of the benchmarks it overlaps
+static std::vector<Result> Measure(const std::vector<Benchmark>& benchmarks) {
+    std::vector<std::vector<double>> times(benchmarks.size());
+    for (int round = 0; round < REPETITIONS; ++round) {
+        for (size_t i = 0; i < benchmarks.size(); ++i) times[i].push_back(benchmarks[i].run());
+    }
+
+    std::vector<Result> results;
+    for (size_t i = 0; i < benchmarks.size(); ++i) {
+        std::sort(times[i].begin(), times[i].end());
+        double spread = 100.0 * (times[i][SPREAD_RANK] - times[i][0]) / times[i][0];
+        results.push_back({ benchmarks[i].name, times[i][0], benchmarks[i].unit, spread });
+    }
+    return results;
+}
+
+// Opcode classes: a straight run of one kind of instruction closed by JMP back to the start
+struct OpcodeClass {
+    const char* name;
+    std::vector<uint8_t> body; // Repeated to fill the loop
+};
+
+static const OpcodeClass OPCODE_CLASSES[] = {
+    { "mov", { 0x41, 0x4A, 0x53, 0x5C } }, // MOV B,C / MOV C,D / MOV D,E / MOV E,H
+    { "alu", { 0x80, 0x91, 0xA2, 0xB3 } }, // ADD B / SUB C / ANA D / ORA E
+    { "immediate", { 0x3E, 0x05, 0xC6, 0x01, 0xFE, 0x10 } }, // MVI A / ADI / CPI
+    { "memory", { 0x7E, 0x77, 0x1A, 0x12 } }, // MOV A,M / MOV M,A / LDAX D / STAX D
+    { "register_pair", { 0x23, 0x1B, 0x09, 0x01, 0x00, 0x00 } }, // INX H / DCX D / DAD B / LXI B
+    { "stack", { 0xC5, 0xD5, 0xD1, 0xC1 } }, // PUSH B / PUSH D / POP D / POP B
+    { "io", { 0xD3, 0x04, 0xDB, 0x03 } }, // OUT 4 / IN 3
+};
+
+static double TimeOpcodeClass(const OpcodeClass& opcodeClass, int instructions) {
+    static CPU8080 cpu;
+    cpu.Reset();
+    cpu.verbose = false;
+    cpu.idleSkipping = false;
+
+    const uint16_t start = 0x0100;
+    uint8_t code[256];
+    int size = 0;
+    while (size + (int)opcodeClass.body.size() + 3 <= (int)sizeof(code)) {
+        std::memcpy(code + size, opcodeClass.body.data(), opcodeClass.body.size());
+        size += opcodeClass.body.size();
+    }
+    code[size++] = 0xC3; // JMP start
+    code[size++] = start & 0xFF;
+    code[size++] = start >> 8;
+
+    cpu.memory.Load(start, code, size);
+    cpu.PC = start;
+    cpu.SP = 0x2400;
+    cpu.H = 0x24; cpu.L = 0x00;
+    cpu.D = 0x28; cpu.E = 0x00;
+
+    auto begin = std::chrono::steady_clock::now();
+    for (int i = 0; i < instructions; ++i) {
+        cpu.EmulateCycle();
+    }
+    return Seconds(begin) * 1e9 / instructions;
+}
+
+// Chains of control transfers, each target being the next instruction
+static double TimeBranches(bool call, int instructions) {
+    static CPU8080 cpu;
+    cpu.Reset();
+    cpu.verbose = false;
+    cpu.idleSkipping = false;
+
+    const uint16_t start = 0x0100, subroutine = 0x0400;
+    uint8_t code[255];
+    int size = 0;
+    while (size + 6 <= (int)sizeof(code)) {
+        uint16_t next = start + size + 3;
+        code[size++] = call ? 0xCD : 0xC3; // CALL subroutine / JMP next
+        code[size++] = call ? subroutine & 0xFF : next & 0xFF;
+        code[size++] = call ? subroutine >> 8 : next >> 8;
+    }
+    code[size++] = 0xC3; // JMP start
+    code[size++] = start & 0xFF;
+    code[size++] = start >> 8;
+
+    const uint8_t ret = 0xC9;
+    cpu.memory.Load(start, code, size);
+    cpu.memory.Load(subroutine, &ret, 1);
+    cpu.PC = start;
+    cpu.SP = 0x2400;
+
+    auto begin = std::chrono::steady_clock::now();
+    for (int i = 0; i < instructions; ++i) {
+        cpu.EmulateCycle();
+    }
+    return Seconds(begin) * 1e9 / instructions;
+}
+
+static void OpcodeBenchmarks(std::vector<Benchmark>& benchmarks) {
+    const int instructions = 2000000;
+    for (const OpcodeClass& opcodeClass : OPCODE_CLASSES) {
+        const OpcodeClass* timed = &opcodeClass;
+        benchmarks.push_back({ std::string("opcode/") + opcodeClass.name, "ns/instruction",
+                               [=] { return TimeOpcodeClass(*timed, instructions); } });
+    }
+    benchmarks.push_back({ "opcode/jump", "ns/instruction", [=] { return TimeBranches(false, instructions); } });
+    benchmarks.push_back({ "opcode/call_return", "ns/instruction", [=] { return TimeBranches(true, instructions); } });
+}
+
+static void MemoryBenchmarks(std::vector<Benchmark>& benchmarks) {
+    static Memory memory;
+    memory.SetReadOnly(0x0000, CPU8080::ROM_SIZE);
+    const int accesses = 10000000;
+
+    benchmarks.push_back({ "memory/read", "ns/access", [=] {
+        auto begin = std::chrono::steady_clock::now();
+        uint8_t sum = 0;
+        for (int i = 0; i < accesses; ++i) sum += memory.Read((uint16_t)(i * 7));
+        sink = sum;
+        return Seconds(begin) * 1e9 / accesses;
+    } });
+
+    benchmarks.push_back({ "memory/write_ram", "ns/access", [=] {
+        auto begin = std::chrono::steady_clock::now();
+        for (int i = 0; i < accesses; ++i) memory.Write(0x2000 + (i & 0x1FFF), (uint8_t)i);
+        return Seconds(begin) * 1e9 / accesses;
+    } });
+
+    benchmarks.push_back({ "memory/write_rom_discarded", "ns/access", [=] {
+        auto begin = std::chrono::steady_clock::now();
+        for (int i = 0; i < accesses; ++i) memory.Write(i & 0x1FFF, (uint8_t)i);
+        return Seconds(begin) * 1e9 / accesses;
+    } });
+
+    // First write to a page shared with a snapshot copies it
+    benchmarks.push_back({ "memory/write_shared_page", "ns/write", [] {
+        const int copies = 100000;
+        double seconds = 0;
+        for (int i = 0; i < copies; ++i) {
+            Memory snapshot = memory;
+            auto begin = std::chrono::steady_clock::now();
+            memory.Write(0x2000 + (i & 0x1FFF), (uint8_t)i);
+            seconds += Seconds(begin);
+        }
+        return seconds * 1e9 / copies;
+    } });
+}
+
+static void SnapshotBenchmarks(std::vector<Benchmark>& benchmarks, const char** roms) {
+    static CPU8080 cpu;
+    cpu.verbose = false;
+    std::streambuf* output = std::cout.rdbuf(nullptr); // LoadProgram reports every ROM file
+    cpu.LoadProgram(roms[0], roms[1], roms[2], roms[3]);
+    std::cout.rdbuf(output);
+    for (int i = 0; i < 120; ++i) cpu.RunFrame();
+    const int iterations = 200000;
+
+    static CPUSnapshot snapshot;
+    benchmarks.push_back({ "snapshot/save_restore", "ns/operation", [=] {
+        auto begin = std::chrono::steady_clock::now();
+        for (int i = 0; i < iterations; ++i) {
+            cpu.SaveState(snapshot);
+            cpu.LoadState(snapshot);
+        }
+        return Seconds(begin) * 1e9 / iterations;
+    } });
+
+    benchmarks.push_back({ "snapshot/fork", "ns/operation", [=] {
+        auto begin = std::chrono::steady_clock::now();
+        for (int i = 0; i < iterations; ++i) {
+            CPU8080 child = cpu.Fork();
+            child.A ^= 1;
+        }
+        return Seconds(begin) * 1e9 / iterations;
+    } });
+}
+
+// Plain white output, then the display filter's settings: the overlay should cost nothing
+static void FramebufferBenchmarks(std::vector<Benchmark>& benchmarks) {
+    static uint8_t vram[0x1C00];
+    static uint32_t pixels[DisplayFilter::WIDTH * DisplayFilter::MAX_SCALE * DisplayFilter::HEIGHT * DisplayFilter::MAX_SCALE];
+    for (int i = 0; i < (int)sizeof(vram); ++i) vram[i] = (uint8_t)(i * 37);
+    const int frames = 2000;
+
+    struct { const char* name; bool overlay; bool scanlines; int scale; } settings[] = {
+        { "framebuffer/convert", false, false, 1 },
+        { "framebuffer/overlay", true, false, 1 },
+        { "framebuffer/overlay_scale2", true, false, 2 },
+        { "framebuffer/overlay_scale3_scanlines", true, true, 3 },
+    };
+    static DisplayFilter filters[sizeof(settings) / sizeof(settings[0])];
+    for (size_t setting = 0; setting < sizeof(settings) / sizeof(settings[0]); ++setting) {
+        DisplayFilter* filter = &filters[setting];
+        filter->SetOverlay(settings[setting].overlay);
+        filter->SetScanlines(settings[setting].scanlines);
+        filter->SetScale(settings[setting].scale);
+        int scaledFrames = frames / (settings[setting].scale * settings[setting].scale);
+        benchmarks.push_back({ settings[setting].name, "us/frame", [=] {
+            auto begin = std::chrono::steady_clock::now();
+            for (int i = 0; i < scaledFrames; ++i) {
+                vram[i % sizeof(vram)] ^= 1;
+                filter->Convert(vram, 0, DisplayFilter::WIDTH, pixels, filter->Width() * sizeof(uint32_t));
+            }
+            return Seconds(begin) * 1e6 / scaledFrames;
+        } });
+    }
+}
+
+// Port 1 bits of the cabinet
+static const uint8_t COIN = 1 << 0, P1_START = 1 << 2, P1_FIRE = 1 << 4, P1_LEFT = 1 << 5, P1_RIGHT = 1 << 6;
+
+// Scripted input: insert a coin, start a game, then move back and forth while firing
+static uint8_t ScriptedInput(int frame) {
+    uint8_t port = 1 << 3; // Always on
+    if (frame >= 60 && frame < 66) port |= COIN;
+    if (frame >= 120 && frame < 126) port |= P1_START;
+    if (frame >= 180) {
+        port |= (frame / 60) % 2 ? P1_LEFT : P1_RIGHT;
+        if (frame % 20 < 5) port |= P1_FIRE;
+    }
+    return port;
+}
+
+enum Configuration { DEFAULT, ACCURATE, FUSED, HLE };
+
+static double TimeRom(const char** roms, Configuration configuration, int frames) {
+    static CPU8080 cpu;
+    cpu.Reset();
+    cpu.verbose = false;
+    cpu.hleHooks = 0;
+    std::streambuf* output = std::cout.rdbuf(nullptr); // LoadProgram reports every ROM file
+    cpu.LoadProgram(roms[0], roms[1], roms[2], roms[3]);
+    std::cout.rdbuf(output);
+    cpu.idleSkipping = configuration != ACCURATE;
+    cpu.EnableSuperinstructions(configuration == FUSED);
+    if (configuration == HLE) cpu.EnableHle(false);
+
+    auto begin = std::chrono::steady_clock::now();
+    for (int i = 0; i < frames; ++i) {
+        cpu.port1 = ScriptedInput(i);
+        cpu.RunFrame();
+    }
+    return Seconds(begin) * 1e6 / frames;
+}
+
+static void RomBenchmarks(std::vector<Benchmark>& benchmarks, const char** roms) {
+    const int frames = 600;
+    const char* names[] = { "rom/default", "rom/accurate", "rom/fused", "rom/hle" };
+    for (int configuration = DEFAULT; configuration <= HLE; ++configuration) {
+        benchmarks.push_back({ names[configuration], "us/frame",
+                               [=] { return TimeRom(roms, (Configuration)configuration, frames); } });
+    }
+}
+
+// Integer work of the same kind as the interpreter's: dependent table loads and
+// data-dependent branches, independent of the emulator's code
+static double TimeCalibration(int iterations) {
+    static uint8_t table[0x10000];
+    for (int i = 0; i < 0x10000; ++i) table[i] = (uint8_t)(i * 0x9D + (i >> 8));
+
+    uint32_t state = 1;
+    uint32_t sum = 0;
+    auto begin = std::chrono::steady_clock::now();
+    for (int i = 0; i < iterations; ++i) {
+        state ^= state << 13;
+        state ^= state >> 17;
+        state ^= state << 5;
+        uint8_t value = table[(state ^ sum) & 0xFFFF];
+        if (value & 1) {
+            sum += value;
+        } else {
+            sum ^= state;
+        }
+    }
+    double time = Seconds(begin) * 1e9 / iterations;
+    sink = sum;
+    return time;
+}
+
+static void CalibrationBenchmark(std::vector<Benchmark>& benchmarks) {
+    benchmarks.push_back({ CALIBRATION, "ns/iteration", [] { return TimeCalibration(20000000); } });
+}
+
+static void WriteJson(std::ostream& out, const std::vector<Result>& results) {
+    out << "{" << std::endl << "  \"benchmarks\": [" << std::endl;
+    for (size_t i = 0; i < results.size(); ++i) {
+        out << "    {\"name\": \"" << results[i].name << "\", \"value\": " << std::setprecision(6) << results[i].value
+            << ", \"unit\": \"" << results[i].unit << "\", \"spread\": " << std::setprecision(3) << results[i].spread << "}"
+            << (i + 1 < results.size() ? "," : "") << std::endl;
+    }
+    out << "  ]" << std::endl << "}" << std::endl;
+}
+
+// Reads the files WriteJson produces: one benchmark object per line
+static std::map<std::string, Result> ReadBaseline(const char* path) {
+    std::map<std::string, Result> baseline;
+    std::ifstream file(path);
+    if (!file.is_open()) {
+        std::cerr << "Error: Could not open baseline " << path << std::endl;
+        exit(1);
+    }
+
+    std::string line;
+    while (std::getline(file, line)) {
+        size_t name = line.find("\"name\": \"");
+        size_t value = line.find("\"value\": ");
+        size_t spread = line.find("\"spread\": ");
+        if (name == std::string::npos || value == std::string::npos) continue;
+        name += 9;
+        Result& entry = baseline[line.substr(name, line.find('"', name) - name)];
+        entry.value = std::atof(line.c_str() + value + 9);
+        entry.spread = spread == std::string::npos ? 0 : std::atof(line.c_str() + spread + 10);
+    }
+    return baseline;
+}
+
+// Prints every benchmark against the baseline and returns the names of those that regressed. A benchmark regresses
+// when it is slower than the baseline by more than threshold percent plus the spread of both runs.
+// Baseline values are scaled by how the calibration changed, when both runs have it. That scale is only
+// an estimate: load from other processes does not slow every benchmark by the same factor, and the
+// calibration has noise of its own, so the tolerance also grows by HOST_DRIFT_WEIGHT times the change.
+static std::vector<std::string> Compare(const std::vector<Result>& results, const std::map<std::string, Result>& baseline,
+                                        double threshold) {
+    double hostScale = 1;
+    auto baseCalibration = baseline.find(CALIBRATION);
+    for (const Result& result : results) {
+        if (result.name == CALIBRATION && baseCalibration != baseline.end() && baseCalibration->second.value > 0) {
+            hostScale = result.value / baseCalibration->second.value;
+        }
+    }
+
+    double hostDrift = HOST_DRIFT_WEIGHT * 100.0 * std::abs(hostScale - 1);
+
+    std::vector<std::string> regressions;
+    std::cout << std::fixed << std::setprecision(3);
+    if (!baseline.empty()) {
+        std::cout << "Host speed against the baseline: x" << 1 / hostScale << ", baseline values scaled to match" << std::endl;
+        std::cout << "Tolerances widened by " << std::setprecision(1) << hostDrift << "% for the change in host speed"
+                  << std::setprecision(3) << std::endl;
+        std::cout << std::left << std::setw(38) << "benchmark" << std::right << std::setw(12) << "fastest" << " "
+                  << std::left << std::setw(16) << "unit" << std::right << std::setw(12) << "expected" << std::setw(10)
+                  << "change" << std::setw(11) << "tolerance" << std::endl;
+    }
+    for (const Result& result : results) {
+        std::cout << std::left << std::setw(38) << result.name << std::right << std::setw(12) << result.value << " "
+                  << std::left << std::setw(16) << result.unit << std::right;
+        auto reference = baseline.find(result.name);
+        if (reference == baseline.end() || reference->second.value <= 0) {
+            std::cout << "(no baseline)" << std::endl;
+            continue;
+        }
+
+        double expected = result.name == CALIBRATION ? reference->second.value : reference->second.value * hostScale;
+        double change = 100.0 * (result.value - expected) / expected;
+        double tolerance = threshold + reference->second.spread + result.spread + hostDrift;
+        std::cout << std::setw(12) << expected << std::showpos << std::setw(9) << std::setprecision(1) << change
+                  << std::noshowpos << "%" << std::setw(10) << tolerance << "%" << std::setprecision(3);
+        if (change > tolerance && result.name != CALIBRATION) {
+            std::cout << "  REGRESSION";
+            regressions.push_back(result.name);
+        }
+        std::cout << std::endl;
+    }
+    return regressions;
+}
+
+int main(int argc, char** argv) {
+    if (argc < 5) {
+        std::cerr << "Usage: " << argv[0] << " invaders.h invaders.g invaders.f invaders.e"
+                  << " [--json file] [--baseline file] [--threshold percent]" << std::endl;
+        return 1;
+    }
+    const char* roms[] = { argv[1], argv[2], argv[3], argv[4] };
+
+    const char* jsonPath = nullptr;
+    const char* baselinePath = nullptr;
+    double threshold = 10.0;
+    for (int i = 5; i < argc; ++i) {
+        std::string option = argv[i];
+        if (option == "--json" && i + 1 < argc) {
+            jsonPath = argv[++i];
+        } else if (option == "--baseline" && i + 1 < argc) {
+            baselinePath = argv[++i];
+        } else if (option == "--threshold" && i + 1 < argc) {
+            threshold = std::atof(argv[++i]);
+        } else {
+            std::cerr << "Unknown option: " << option << std::endl;
+            return 1;
+        }
+    }
+
+    std::vector<Benchmark> benchmarks;
+    CalibrationBenchmark(benchmarks);
+    OpcodeBenchmarks(benchmarks);
+    MemoryBenchmarks(benchmarks);
+    SnapshotBenchmarks(benchmarks, roms);
+    FramebufferBenchmarks(benchmarks);
+    RomBenchmarks(benchmarks, roms);
+    std::vector<Result> results = Measure(benchmarks);
+
+    if (jsonPath) {
+        std::ofstream json(jsonPath);
+        WriteJson(json, results);
+    }
+
+    std::map<std::string, Result> baseline;
+    if (baselinePath) baseline = ReadBaseline(baselinePath);
+    std::vector<std::string> regressions = Compare(results, baseline, threshold);
+
+    // A slow spell can outlast every round of a benchmark, so a regression only counts when
+    // a second measurement of it, with the calibration, confirms it
+    if (!regressions.empty()) {
+        std::cout << "Measuring the regressed benchmarks again" << std::endl;
+        std::vector<Benchmark> again;
+        for (const Benchmark& benchmark : benchmarks) {
+            if (benchmark.name == CALIBRATION || std::count(regressions.begin(), regressions.end(), benchmark.name)) {
+                again.push_back(benchmark);
+            }
+        }
+        regressions = Compare(Measure(again), baseline, threshold);
+    }
+
+    if (!regressions.empty()) {
+        std::cout << regressions.size() << " benchmark(s) regressed by more than " << std::setprecision(1) << threshold
+                  << "% plus their spread" << std::endl;
+        return 2;
+    }
+    return 0;
+}
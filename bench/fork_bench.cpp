@@ -0,0 +1,89 @@
+// Compares copy-on-write forking of CPU8080 against plain memcpy snapshots.
+// Usage: fork_bench invaders.h invaders.g invaders.f invaders.e [iterations]
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include "../src/cpu.h"
+
+// What a snapshot costs without copy-on-write: registers plus a flat 64KB copy
+struct FlatSnapshot {
+    CPU8080* source;
+    uint8_t A, B, C, D, E, H, L, flags;
+    uint16_t SP, PC;
+    uint8_t memory[0x10000];
+
+    void Save(const CPU8080& cpu) {
+        A = cpu.A; B = cpu.B; C = cpu.C; D = cpu.D; E = cpu.E; H = cpu.H; L = cpu.L;
+        flags = cpu.flags; SP = cpu.SP; PC = cpu.PC;
+        cpu.memory.CopyOut(0x0000, memory, sizeof(memory));
+    }
+
+    void Restore(CPU8080& cpu) const {
+        cpu.A = A; cpu.B = B; cpu.C = C; cpu.D = D; cpu.E = E; cpu.H = H; cpu.L = L;
+        cpu.flags = flags; cpu.SP = SP; cpu.PC = PC;
+        cpu.memory.Load(0x0000, memory, sizeof(memory));
+    }
+};
+
+static double Seconds(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+static void Report(const char* name, int iterations, double seconds) {
+    std::cout << name << ": " << iterations / seconds << " per second ("
+              << seconds * 1e9 / iterations << " ns each)" << std::endl;
+}
+
+int main(int argc, char** argv) {
+    if (argc < 5) {
+        std::cerr << "Usage: " << argv[0] << " invaders.h invaders.g invaders.f invaders.e [iterations]" << std::endl;
+        return 1;
+    }
+    int iterations = argc > 5 ? std::atoi(argv[5]) : 100000;
+
+    static CPU8080 cpu;
+    cpu.verbose = false;
+    cpu.LoadProgram(argv[1], argv[2], argv[3], argv[4]);
+    for (int i = 0; i < 120; ++i) cpu.RunFrame();
+
+    static FlatSnapshot flat;
+
+    // Snapshot cost alone
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < iterations; ++i) {
+        CPU8080 child = cpu.Fork();
+        child.A ^= 1; // Keep the fork observable
+    }
+    Report("fork + discard", iterations, Seconds(start));
+
+    start = std::chrono::steady_clock::now();
+    for (int i = 0; i < iterations; ++i) {
+        flat.Save(cpu);
+        flat.Restore(cpu);
+    }
+    Report("memcpy save + restore", iterations, Seconds(start));
+
+    // Tree-search pattern: branch, run one frame, throw the branch away
+    int branches = iterations / 100 > 0 ? iterations / 100 : 1;
+    start = std::chrono::steady_clock::now();
+    int touched = 0;
+    for (int i = 0; i < branches; ++i) {
+        CPU8080 child = cpu.Fork();
+        child.RunFrame();
+        touched += Memory::PAGE_COUNT - child.memory.SharedPages();
+    }
+    Report("fork + 1 frame + discard", branches, Seconds(start));
+    std::cout << "pages duplicated per branch: " << (double)touched / branches
+              << " of " << Memory::PAGE_COUNT << std::endl;
+
+    start = std::chrono::steady_clock::now();
+    for (int i = 0; i < branches; ++i) {
+        flat.Save(cpu);
+        cpu.RunFrame();
+        flat.Restore(cpu);
+    }
+    Report("memcpy + 1 frame + restore", branches, Seconds(start));
+
+    return 0;
+}
@@ -0,0 +1,148 @@
+// Throughput and consistency of the shared memory screen export. A writer publishes
+// frames through ScreenExport while reader threads map the segment read-only, as
+// another process would, and read the newest frame in place. Every frame carries a
+// pattern derived from its number, so a read the seqlock accepted but that mixed two
+// frames is caught. Reports the writer's cost per frame alone and under readers, the
+// cost of reading a frame in place, and the readers' rate while the writer runs flat
+// out; exits 1 on any torn read.
+// Usage: shared_screen_bench [seconds] [readers]
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include "../src/screen_export.h"
+
+static double Seconds(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+struct ReaderResult {
+    uint64_t frames; // Distinct frames read
+    uint64_t retries; // Reads the seqlock rejected
+    uint64_t torn; // Reads it accepted that were not one frame
+};
+
+// Frame number to VRAM byte and port 1 value, so that any two consecutive frames differ
+static uint8_t Pattern(uint64_t frame) {
+    return (uint8_t)(frame * 0x9D + 1);
+}
+
+static const shared_screen* Map(const char* name) {
+    int fd = shm_open(name, O_RDONLY, 0);
+    void* memory = fd < 0 ? MAP_FAILED : mmap(nullptr, sizeof(shared_screen), PROT_READ, MAP_SHARED, fd, 0);
+    if (fd >= 0) close(fd);
+    if (memory == MAP_FAILED) {
+        std::cerr << "Error: Could not map " << name << std::endl;
+        exit(1);
+    }
+    return static_cast<const shared_screen*>(memory);
+}
+
+// Read the newest frame in place and check it, working on every byte as a consumer scanning the screen would.
+// False if the seqlock rejected the read.
+static bool ReadNewest(const shared_screen* screen, ReaderResult& result, uint64_t& lastFrame) {
+    const shared_screen_slot* slot = &screen->slots[shared_screen_latest(screen)];
+    uint32_t sequence = shared_screen_begin_read(slot);
+    uint64_t frame = slot->frame;
+    uint8_t expected = Pattern(frame);
+    bool consistent = slot->port1 == expected;
+    for (int i = 0; i < SHARED_SCREEN_VRAM_SIZE; ++i) consistent &= slot->vram[i] == expected;
+    if (!shared_screen_end_read(slot, sequence)) {
+        result.retries++;
+        return false;
+    }
+    if (!consistent) result.torn++;
+    if (frame != lastFrame) result.frames++;
+    lastFrame = frame;
+    return true;
+}
+
+static void Read(const char* name, std::atomic<int>& ready, std::atomic<bool>& done, ReaderResult& result) {
+    const shared_screen* screen = Map(name);
+    result = {};
+    uint64_t lastFrame = 0;
+    ready++;
+    while (!done.load(std::memory_order_relaxed)) ReadNewest(screen, result, lastFrame);
+    munmap(const_cast<shared_screen*>(screen), sizeof(shared_screen));
+}
+
+// Publish frames first to first + count - 1 and return nanoseconds per frame
+static double Publish(ScreenExport& screenExport, CPU8080& cpu, uint64_t first, uint64_t count) {
+    static uint8_t vram[SHARED_SCREEN_VRAM_SIZE];
+    double total = 0;
+    for (uint64_t frame = first; frame < first + count; ++frame) {
+        uint8_t value = Pattern(frame);
+        for (uint8_t& byte : vram) byte = value; // Not timed: the emulator has the frame already
+        cpu.port1 = value;
+        auto start = std::chrono::steady_clock::now();
+        screenExport.Publish(frame, vram, cpu);
+        total += Seconds(start);
+    }
+    return total * 1e9 / count;
+}
+
+int main(int argc, char** argv) {
+    double seconds = argc > 1 ? std::atof(argv[1]) : 2;
+    int readers = argc > 2 ? std::atoi(argv[2]) : 2;
+    std::string name = "/space_invaders_bench_" + std::to_string(getpid());
+    const uint64_t frames = 100000;
+
+    static CPU8080 cpu;
+    ScreenExport screenExport;
+    screenExport.Open(name);
+
+    double alone = Publish(screenExport, cpu, 1, frames);
+    std::cout << "publish, no readers: " << alone << " ns per frame, " << SHARED_SCREEN_VRAM_SIZE / alone << " GB/s" << std::endl;
+
+    // The newest frame over and over, nothing writing
+    const shared_screen* screen = Map(name.c_str());
+    ReaderResult idle = {};
+    uint64_t lastFrame = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (uint64_t i = 0; i < frames; ++i) ReadNewest(screen, idle, lastFrame);
+    std::cout << "read in place, no writer: " << Seconds(start) * 1e9 / frames << " ns per frame" << std::endl;
+    munmap(const_cast<shared_screen*>(screen), sizeof(shared_screen));
+
+    std::atomic<int> ready(0);
+    std::atomic<bool> done(false);
+    std::vector<ReaderResult> results(readers);
+    std::vector<std::thread> threads;
+    for (int i = 0; i < readers; ++i) {
+        threads.emplace_back(Read, name.c_str(), std::ref(ready), std::ref(done), std::ref(results[i]));
+    }
+    while (ready < readers) std::this_thread::yield();
+
+    uint64_t published = 0;
+    double publishTime = 0;
+    start = std::chrono::steady_clock::now();
+    while (Seconds(start) < seconds) {
+        publishTime += Publish(screenExport, cpu, frames + 1 + published, 1000) * 1000;
+        published += 1000;
+    }
+    double elapsed = Seconds(start);
+    done = true;
+    for (std::thread& thread : threads) thread.join();
+
+    double contended = publishTime / published;
+    std::cout << "publish, " << readers << " readers: " << contended << " ns per frame, " << published / elapsed / 1e6
+              << " million frames per second" << std::endl;
+    uint64_t torn = idle.torn;
+    for (int i = 0; i < readers; ++i) {
+        const ReaderResult& result = results[i];
+        std::cout << "reader " << i << ": " << result.frames / elapsed << " distinct frames per second, " << result.retries
+                  << " retries, " << result.torn << " torn" << std::endl;
+        torn += result.torn;
+    }
+    std::cout << "seqlock: " << (torn ? "FAIL" : "ok") << " (" << std::thread::hardware_concurrency() << " host threads)" << std::endl;
+
+    // At 60 frames per second the emulator spends this much of each frame period exporting
+    std::cout << "export cost at 60 Hz: " << contended * 60 / 1e7 << "% of a frame period" << std::endl;
+    screenExport.Close();
+    return torn ? 1 : 0;
+}
@@ -0,0 +1,136 @@
+// Checks the shift register device against a bit-level model and measures the ways the
+// emulator drives it: one OUT 4 / IN 3 pair at a time through the I/O bus, batched
+// through ShiftRegister::Shift, and whole sprite routines interpreted or through HLE.
+// Usage: shift_register_bench invaders.h invaders.g invaders.f invaders.e [iterations]
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include "../src/cpu.h"
+
+static double Seconds(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+static void Report(const char* name, uint64_t iterations, double seconds, const char* unit) {
+    std::cout << name << ": " << iterations / seconds / 1e6 << " million " << unit << " per second ("
+              << seconds * 1e9 / iterations << " ns each)" << std::endl;
+}
+
+// The result port shows bits 15-offset down to 8-offset of the last two bytes written
+static uint8_t Expected(uint8_t older, uint8_t newer, int offset) {
+    uint8_t result = 0;
+    for (int bit = 0; bit < 8; ++bit) {
+        int source = bit + 8 - offset; // Bit of newer:older
+        int value = source >= 8 ? (newer >> (source - 8)) & 1 : (older >> source) & 1;
+        result |= value << bit;
+    }
+    return result;
+}
+
+// Every offset and pair of bytes through the bus and through the batched path
+static int CheckDevice(CPU8080& cpu) {
+    int failures = 0;
+    for (int offset = 0; offset < 8; ++offset) {
+        cpu.OutPort(2, offset | 0xF8); // Only bits 0-2 count
+        for (int older = 0; older < 256; ++older) {
+            for (int newer = 0; newer < 256; ++newer) {
+                cpu.OutPort(4, older);
+                cpu.OutPort(4, newer);
+                uint8_t viaBus = cpu.InPort(3);
+
+                ShiftRegister batched = {};
+                batched.WriteOffset(offset);
+                const uint8_t data[2] = { (uint8_t)older, (uint8_t)newer };
+                uint8_t results[2];
+                batched.Shift(data, results, 2);
+
+                uint8_t expected = Expected(older, newer, offset);
+                if ((viaBus != expected || results[1] != expected) && failures++ < 10) {
+                    std::cerr << "offset " << offset << ", bytes " << older << " then " << newer << ": expected "
+                              << (int)expected << ", bus " << (int)viaBus << ", batched " << (int)results[1] << std::endl;
+                }
+            }
+        }
+    }
+    return failures;
+}
+
+// Call a ROM routine from a RAM address it never touches and run until it returns
+static void CallRoutine(CPU8080& cpu, uint16_t address) {
+    const uint16_t returnAddress = 0x23F0;
+    cpu.SP = 0x2400;
+    cpu.PC = returnAddress - 3; // CALL address, pushing returnAddress
+    cpu.memory.Write(cpu.PC, 0xCD);
+    cpu.memory.Write(cpu.PC + 1, address & 0xFF);
+    cpu.memory.Write(cpu.PC + 2, address >> 8);
+    while (!(cpu.PC == returnAddress && cpu.SP == 0x2400)) cpu.EmulateCycle();
+}
+
+int main(int argc, char** argv) {
+    if (argc < 5) {
+        std::cerr << "Usage: " << argv[0] << " invaders.h invaders.g invaders.f invaders.e [iterations]" << std::endl;
+        return 1;
+    }
+    int iterations = argc > 5 ? std::atoi(argv[5]) : 100000;
+
+    static CPU8080 cpu;
+    cpu.verbose = false;
+    cpu.idleSkipping = false;
+    cpu.LoadProgram(argv[1], argv[2], argv[3], argv[4]);
+
+    int failures = CheckDevice(cpu);
+    std::cout << "shift register: " << (failures ? "FAIL" : "ok") << " (" << 8 * 256 * 256 << " cases)" << std::endl;
+
+    // Sprite rows as DrawShiftedSprite issues them: sprite byte then 0
+    const int rows = 16;
+    uint8_t data[2 * rows] = {};
+    for (int i = 0; i < rows; ++i) data[2 * i] = cpu.memory.Read(0x1C00 + i);
+    uint8_t results[2 * rows];
+    uint32_t checksum = 0;
+
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < iterations; ++i) {
+        cpu.OutPort(2, i);
+        for (int j = 0; j < 2 * rows; ++j) {
+            cpu.OutPort(4, data[j]);
+            checksum += cpu.InPort(3);
+        }
+    }
+    Report("OUT 4 / IN 3 through the bus", (uint64_t)iterations * 2 * rows, Seconds(start), "pairs");
+
+    start = std::chrono::steady_clock::now();
+    for (int i = 0; i < iterations; ++i) {
+        cpu.shifter.WriteOffset(i);
+        cpu.shifter.Shift(data, results, 2 * rows);
+        checksum -= results[i % (2 * rows)];
+    }
+    Report("ShiftRegister::Shift, 32 bytes a call", (uint64_t)iterations * 2 * rows, Seconds(start), "pairs");
+
+    // Whole routines: 16-row sprites at the pixel used by the HLE differential test
+    struct { const char* name; uint16_t address; } routines[] = {
+        { "DrawShiftedSprite", 0x1400 }, { "EraseShifted", 0x1452 }, { "DrawSprite", 0x15D3 },
+    };
+    int calls = iterations / 10 > 0 ? iterations / 10 : 1;
+    cpu.EnableHle(false);
+    uint32_t hooks = cpu.hleHooks;
+    for (const auto& routine : routines) {
+        for (int hle = 0; hle < 2; ++hle) {
+            cpu.hleHooks = hle ? hooks : 0;
+            uint64_t cycles = cpu.cycles;
+            start = std::chrono::steady_clock::now();
+            for (int i = 0; i < calls; ++i) {
+                cpu.B = rows;
+                cpu.D = 0x1C; cpu.E = 0x00;
+                cpu.H = 0x2C; cpu.L = 0x80 + (i & 7);
+                CallRoutine(cpu, routine.address);
+            }
+            double seconds = Seconds(start);
+            std::cout << routine.name << (hle ? " HLE" : " interpreted") << ": " << calls / seconds / 1e6
+                      << " million calls per second, " << (cpu.cycles - cycles) / seconds / CPU8080::CLOCK_RATE
+                      << "x a 2 MHz 8080" << std::endl;
+        }
+    }
+
+    std::cout << "(checksum " << checksum << ")" << std::endl;
+    return failures ? 1 : 0;
+}
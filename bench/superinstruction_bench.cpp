@@ -0,0 +1,127 @@
+// Profiles instruction sequences in the ROM and measures each superinstruction.
+// Usage: superinstruction_bench invaders.h invaders.g invaders.f invaders.e [frames]
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include "../src/cpu.h"
+#include "../src/opcodes.h"
+
+static double Seconds(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+// Run the sequence in a loop (sequence + JMP back) for a fixed number of emulated cycles
+static double TimeSequence(const Superinstruction& sequence, bool fused, uint64_t cycles, uint64_t& iterations) {
+    static CPU8080 cpu;
+    cpu.Reset();
+    cpu.verbose = false;
+    cpu.idleSkipping = false;
+
+    const uint16_t start = 0x0100;
+    uint8_t code[32];
+    int size = 0;
+    for (int i = 0; i < sequence.length; ++i) {
+        uint8_t opcode = sequence.opcodes[i];
+        code[size++] = opcode;
+        if (OPCODES[opcode].length == 2) {
+            code[size++] = 0x00;
+        } else if (OPCODES[opcode].length == 3) {
+            // Jumps loop back to the start, data operands point into RAM
+            bool jump = OPCODES[opcode].flow == FLOW_JUMP;
+            code[size++] = jump ? start & 0xFF : 0x20;
+            code[size++] = jump ? start >> 8 : 0x20;
+        }
+    }
+    code[size++] = 0xC3; // JMP start
+    code[size++] = start & 0xFF;
+    code[size++] = start >> 8;
+
+    cpu.memory.Load(start, code, size);
+    cpu.memory.SetReadOnly(0x0000, CPU8080::ROM_SIZE);
+    cpu.EnableSuperinstructions(fused);
+    cpu.PC = start;
+    cpu.SP = 0x2400;
+    cpu.H = 0x24; cpu.L = 0x00;
+    cpu.D = 0x28; cpu.E = 0x00;
+
+    uint64_t passes = 0;
+    auto begin = std::chrono::steady_clock::now();
+    while (cpu.cycles < cycles) {
+        if (cpu.PC == start) passes++;
+        cpu.EmulateCycle();
+    }
+    iterations = passes;
+    return Seconds(begin);
+}
+
+// Whole ROM without idle skipping, which would skip most of the frame and leave little to fuse.
+// The plain and the fused machine take turns every few frames so that both see the same host load.
+static void TimeFrames(const char** roms, int frames, double& plain, double& fused) {
+    static CPU8080 cpus[2];
+    for (int i = 0; i < 2; ++i) {
+        cpus[i].Reset();
+        cpus[i].verbose = false;
+        cpus[i].idleSkipping = false;
+        cpus[i].LoadProgram(roms[0], roms[1], roms[2], roms[3]);
+        cpus[i].EnableSuperinstructions(i == 1);
+    }
+
+    const int chunk = 10;
+    double times[2] = { 0, 0 };
+    for (int frame = 0; frame < frames; frame += chunk) {
+        for (int i = 0; i < 2; ++i) {
+            auto begin = std::chrono::steady_clock::now();
+            for (int j = frame; j < frames && j < frame + chunk; ++j) cpus[i].RunFrame();
+            times[i] += Seconds(begin);
+        }
+    }
+    plain = times[0];
+    fused = times[1];
+}
+
+int main(int argc, char** argv) {
+    if (argc < 5) {
+        std::cerr << "Usage: " << argv[0] << " invaders.h invaders.g invaders.f invaders.e [frames]" << std::endl;
+        return 1;
+    }
+    const char* roms[4] = { argv[1], argv[2], argv[3], argv[4] };
+    int frames = argc > 5 ? std::atoi(argv[5]) : 3000;
+
+    // Profiling pass over the real ROM
+    {
+        static CPU8080 cpu;
+        SequenceProfile profile;
+        cpu.verbose = false;
+        cpu.idleSkipping = false;
+        cpu.LoadProgram(roms[0], roms[1], roms[2], roms[3]);
+        cpu.sequenceProfile = &profile;
+        for (int i = 0; i < frames; ++i) cpu.RunFrame();
+        profile.Report(std::cout, 15);
+    }
+
+    // Speedup of every fused sequence in isolation, best of alternating runs to keep out host noise
+    std::cout << std::endl << "Per superinstruction (ns per pass of sequence + JMP):" << std::endl;
+    const uint64_t cycles = 20000000;
+    const int repeats = 5;
+    for (int i = 0; i < SUPERINSTRUCTION_COUNT; ++i) {
+        uint64_t plainPasses, fusedPasses;
+        double plain = 0, fused = 0;
+        for (int run = 0; run < repeats; ++run) {
+            double time = TimeSequence(SUPERINSTRUCTIONS[i], false, cycles, plainPasses);
+            if (run == 0 || time < plain) plain = time;
+            time = TimeSequence(SUPERINSTRUCTIONS[i], true, cycles, fusedPasses);
+            if (run == 0 || time < fused) fused = time;
+        }
+        std::cout << "  " << std::left << std::setw(40) << SUPERINSTRUCTIONS[i].name << std::right << std::fixed
+                  << std::setprecision(2) << std::setw(8) << plain * 1e9 / plainPasses << " -> "
+                  << std::setw(8) << fused * 1e9 / fusedPasses << "  x" << plain / fused << std::endl;
+    }
+
+    // Whole ROM
+    double plain, fused;
+    TimeFrames(roms, frames, plain, fused);
+    std::cout << std::endl << "ROM without idle skipping, " << frames << " frames: " << plain * 1000 << " ms -> " << fused * 1000
+              << " ms  x" << plain / fused << std::endl;
+    return 0;
+}
@@ -0,0 +1,180 @@
+#include "audio.h"
+#include <algorithm>
+#include <climits>
+#include <iostream>
+#include "SDL2/SDL.h"
+#include "SDL2/SDL_mixer.h"
+#include "cpu.h"
+
+// File names of the usual Space Invaders sample set; the repo ships shot.wav and explosion.wav
+const Audio::Sound Audio::SOUNDS[] = {
+    { 1, 0, "ufo.wav", true },
+    { 1, 1, "shot.wav", false },
+    { 1, 2, "explosion.wav", false }, // Player death
+    { 1, 3, "invaderkilled.wav", false },
+    { 1, 4, "extendedplay.wav", false },
+    { 2, 0, "fastinvader1.wav", false },
+    { 2, 1, "fastinvader2.wav", false },
+    { 2, 2, "fastinvader3.wav", false },
+    { 2, 3, "fastinvader4.wav", false },
+    { 2, 4, "ufo_highpitch.wav", false },
+};
+const int Audio::SOUND_COUNT = sizeof(SOUNDS) / sizeof(SOUNDS[0]);
+
+static const int OUTPUT_RATE = 48000;
+static const int OUTPUT_CHANNELS = 2;
+static const int OUTPUT_BUFFER = 512; // Frames per mixer callback
+
+Audio::Audio()
+    : open(false), rate(OUTPUT_RATE), channels(OUTPUT_CHANNELS), delay(0), emulatedCycle(NO_CYCLE), latency(0), underruns(0),
+      resyncs(0), position(0), anchored(false), cycleOrigin(0), sampleOrigin(0), amplifier(0) {
+    for (Voice& voice : voices) voice.sample = nullptr;
+}
+
+Audio::~Audio() {
+    Close();
+}
+
+bool Audio::Initialize(const std::string& soundDirectory) {
+    if (SDL_InitSubSystem(SDL_INIT_AUDIO) < 0 || Mix_OpenAudio(OUTPUT_RATE, MIX_DEFAULT_FORMAT, OUTPUT_CHANNELS, OUTPUT_BUFFER) < 0) {
+        std::cerr << "Warning: No audio: " << Mix_GetError() << std::endl;
+        return false;
+    }
+    Uint16 format;
+    if (!Mix_QuerySpec(&rate, &format, &channels) || format != AUDIO_S16SYS) {
+        std::cerr << "Warning: No audio: the device does not take 16-bit samples" << std::endl;
+        Mix_CloseAudio();
+        return false;
+    }
+    open = true;
+
+    // Loaded samples are already in the output format
+    samples.assign(SOUND_COUNT, std::vector<int16_t>());
+    int loaded = 0;
+    for (int i = 0; i < SOUND_COUNT; ++i) {
+        Mix_Chunk* chunk = Mix_LoadWAV((soundDirectory + "/" + SOUNDS[i].file).c_str());
+        if (!chunk) continue;
+        // Whole frames only: a sample without any stays empty, like a missing one, so Mix never wraps by 0
+        const int16_t* data = reinterpret_cast<const int16_t*>(chunk->abuf);
+        size_t frames = chunk->alen / sizeof(int16_t) / channels;
+        samples[i].assign(data, data + frames * channels);
+        Mix_FreeChunk(chunk);
+        if (frames) loaded++;
+    }
+    std::cout << "Audio: " << rate << " Hz, " << channels << " channels, " << loaded << " of " << SOUND_COUNT
+              << " sounds loaded from " << soundDirectory << std::endl;
+
+    // The emulation runs a frame at a time, so events arrive up to a frame ahead of their time
+    delay = rate / 60 + 2 * OUTPUT_BUFFER;
+    mixBuffer.assign(8192 * channels, 0);
+    Mix_HookMusic(&Audio::Callback, this);
+    return true;
+}
+
+void Audio::Close() {
+    if (!open) return;
+    Mix_HookMusic(nullptr, nullptr);
+    Mix_CloseAudio();
+    open = false;
+}
+
+void Audio::Callback(void* audio, uint8_t* stream, int length) {
+    Audio* self = static_cast<Audio*>(audio);
+    int16_t* output = reinterpret_cast<int16_t*>(stream);
+    int frames = length / (int)sizeof(int16_t) / self->channels;
+    // SDL may ask for more than the mix buffer holds: fill the request in chunks
+    int chunk = (int)(self->mixBuffer.size() / self->channels);
+    while (frames > 0) {
+        int count = std::min(frames, chunk);
+        self->Mix(output, count);
+        output += count * self->channels;
+        frames -= count;
+    }
+}
+
+int64_t Audio::FrameAt(uint64_t cycle, int64_t bufferStart) {
+    int64_t frame = sampleOrigin + (int64_t)((double)(int64_t)(cycle - cycleOrigin) * rate / CPU8080::CLOCK_RATE);
+    // First event, or the emulation jumped (turbo, pause, state load): restart the mapping
+    if (!anchored || frame < bufferStart - delay || frame > bufferStart + 4 * delay) {
+        if (anchored) resyncs++;
+        anchored = true;
+        cycleOrigin = cycle;
+        sampleOrigin = bufferStart + delay;
+        frame = sampleOrigin;
+    }
+    return frame;
+}
+
+void Audio::Apply(const SoundEvent& event, int64_t frame) {
+    if (event.bank == 1) amplifier = event.latches & AMPLIFIER_BIT;
+
+    for (int i = 0; i < SOUND_COUNT; ++i) {
+        uint8_t mask = 1 << SOUNDS[i].bit;
+        if (SOUNDS[i].bank != event.bank || !(event.changed & mask) || samples[i].empty()) continue;
+
+        if (!(event.latches & mask)) {
+            // Falling edge: looping sounds stop, one-shot sounds play to the end
+            for (Voice& voice : voices) {
+                if (voice.sample && voice.sound == i) voice.stop = std::min(voice.stop, frame);
+            }
+            continue;
+        }
+        if (!amplifier) continue;
+
+        // Rising edge: a free voice, or the one that started first
+        Voice* target = &voices[0];
+        for (Voice& voice : voices) {
+            if (!voice.sample) {
+                target = &voice;
+                break;
+            }
+            if (voice.start < target->start) target = &voice;
+        }
+        *target = { &samples[i], frame, INT64_MAX, SOUNDS[i].loop, i };
+    }
+}
+
+void Audio::Mix(int16_t* output, int frames) {
+    int64_t end = position + frames;
+
+    const SoundEvent* event;
+    while ((event = events.Peek()) != nullptr) {
+        int64_t frame = FrameAt(event->cycle, position);
+        if (frame >= end) break; // Due in a later buffer
+        Apply(*event, std::max(frame, position)); // Late events play at once
+        SoundEvent done;
+        events.Pop(done);
+    }
+
+    // How far the emulation is ahead of this buffer; less than the buffer means sounds of it will be late
+    uint64_t cycle = emulatedCycle.load(std::memory_order_acquire);
+    if (cycle != NO_CYCLE) {
+        int64_t ahead = FrameAt(cycle, position) - position;
+        latency = 1000.0 * ahead / rate;
+        if (ahead < frames) underruns++;
+    }
+
+    std::fill(mixBuffer.begin(), mixBuffer.begin() + frames * channels, 0);
+    for (Voice& voice : voices) {
+        if (!voice.sample) continue;
+        const std::vector<int16_t>& sample = *voice.sample;
+        int64_t length = sample.size() / channels;
+        for (int i = (int)std::max<int64_t>(0, voice.start - position); i < frames; ++i) {
+            int64_t frame = position + i;
+            int64_t index = frame - voice.start;
+            if (frame >= voice.stop || (index >= length && !voice.loop)) {
+                voice.sample = nullptr;
+                break;
+            }
+            index %= length;
+            for (int channel = 0; channel < channels; ++channel) {
+                mixBuffer[i * channels + channel] += sample[index * channels + channel];
+            }
+        }
+    }
+
+    for (int i = 0; i < frames * channels; ++i) {
+        output[i] = (int16_t)std::max(-32768, std::min(32767, mixBuffer[i]));
+    }
+    position = end;
+}
@@ -0,0 +1,82 @@
+#ifndef AUDIO_H
+#define AUDIO_H
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "devices.h"
+
+// Plays the sound latch events of the emulation thread. Every sample is loaded and
+// converted to the output format at startup; SDL_mixer then calls Mix on its audio
+// thread, which takes the events due in the buffer it is filling and starts each sound
+// at the output sample that matches its emulated cycle. The emulation thread only
+// pushes to the queue: it never calls the mixer and never waits for it.
+class Audio {
+public:
+    Audio();
+    ~Audio();
+
+    bool Initialize(const std::string& soundDirectory); // Open the device and load the samples, false if there is no audio
+    void Close();
+
+    SoundEventQueue* Events() { return &events; } // For CPU8080::soundEvents
+
+    // Emulation thread: emulated time reached, measured against the audio clock on every callback
+    void SetEmulatedCycle(uint64_t cycle) { emulatedCycle.store(cycle, std::memory_order_release); }
+
+    // Emulated time queued ahead of the output, in milliseconds: the audio buffer fill level
+    double Latency() const { return latency; }
+    // Where audio sync holds the average of Latency(): the delay less half a frame, since the
+    // emulation reports once a frame and Latency() falls by a frame in between
+    double TargetLatency() const { return open ? 1000.0 * (delay - rate / 120) / rate : 0; }
+    uint64_t Underruns() const { return underruns; } // Callbacks that found the emulation behind the output
+    uint64_t Resyncs() const { return resyncs; } // Times the cycle to sample mapping had to be restarted
+
+private:
+    // One sound per latch bit; bits without a sample stay silent
+    struct Sound {
+        uint8_t bank;
+        uint8_t bit;
+        const char* file;
+        bool loop; // Plays while the bit is set
+    };
+    static const Sound SOUNDS[];
+    static const int SOUND_COUNT;
+    static const int MAX_VOICES = 16;
+    static const uint8_t AMPLIFIER_BIT = 0x20; // Bank 1: sounds only start while it is set
+
+    struct Voice {
+        const std::vector<int16_t>* sample; // nullptr when free
+        int64_t start; // Output frame of the first sample frame
+        int64_t stop; // Output frame where a looping sound ends
+        bool loop;
+        int sound;
+    };
+
+    static void Callback(void* audio, uint8_t* stream, int length);
+    void Mix(int16_t* output, int frames); // Audio thread, at most mixBuffer.size() / channels frames
+    int64_t FrameAt(uint64_t cycle, int64_t bufferStart); // Output frame of an emulated cycle
+    void Apply(const SoundEvent& event, int64_t frame);
+
+    bool open;
+    int rate, channels;
+    int64_t delay; // Frames between an event's emulated time and its playback
+    std::vector<std::vector<int16_t>> samples; // Per entry of SOUNDS, interleaved; empty when missing or shorter than a frame
+    SoundEventQueue events;
+    std::atomic<uint64_t> emulatedCycle; // NO_CYCLE until the emulation reports
+    std::atomic<double> latency;
+    std::atomic<uint64_t> underruns, resyncs;
+    static const uint64_t NO_CYCLE = ~0ull;
+
+    // Audio thread only
+    Voice voices[MAX_VOICES];
+    std::vector<int32_t> mixBuffer;
+    int64_t position; // Output frames mixed so far
+    bool anchored;
+    uint64_t cycleOrigin; // Emulated cycle that plays at sampleOrigin
+    int64_t sampleOrigin;
+    uint8_t amplifier;
+};
+
+#endif
@@ -0,0 +1,200 @@
+#include "capture.h"
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+static const int WIDTH = 224; // Upright picture
+static const int HEIGHT = 256;
+
+// Pixel (x, y) of the upright picture: VRAM line x, bit 0 of its first byte at the bottom
+static bool Lit(const uint8_t* vram, int x, int y) {
+    int bit = HEIGHT - 1 - y;
+    return (vram[x * VideoFrame::LINE_BYTES + bit / 8] >> (bit % 8)) & 1;
+}
+
+static uint32_t Crc32(const uint8_t* data, size_t size, uint32_t crc = 0) {
+    static uint32_t table[256];
+    if (!table[1]) {
+        for (uint32_t i = 0; i < 256; ++i) {
+            uint32_t value = i;
+            for (int bit = 0; bit < 8; ++bit) value = value & 1 ? 0xEDB88320 ^ (value >> 1) : value >> 1;
+            table[i] = value;
+        }
+    }
+    crc = ~crc;
+    for (size_t i = 0; i < size; ++i) crc = table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+    return ~crc;
+}
+
+static void PutBig32(std::vector<uint8_t>& out, uint32_t value) {
+    for (int shift = 24; shift >= 0; shift -= 8) out.push_back((uint8_t)(value >> shift));
+}
+
+static void PutChunk(std::vector<uint8_t>& out, const char* type, const std::vector<uint8_t>& data) {
+    PutBig32(out, data.size());
+    size_t start = out.size();
+    out.insert(out.end(), type, type + 4);
+    out.insert(out.end(), data.begin(), data.end());
+    PutBig32(out, Crc32(&out[start], out.size() - start));
+}
+
+Capture::Capture()
+    : running(false), screenshotRequested(false), captured(0), dropped(0), screenshots(0), format(NONE), screenshotEvery(0),
+      lastNumber(0) {
+    for (int i = 0; i < POOL_SIZE; ++i) freeBuffers.Push(i);
+}
+
+Capture::~Capture() {
+    Stop();
+}
+
+void Capture::OpenVideo(const std::string& path, uint32_t rateNumerator, uint32_t rateDenominator) {
+    std::string extension = path.size() > 4 ? path.substr(path.size() - 4) : "";
+    if (extension != ".y4m" && extension != ".raw") {
+        std::cerr << "Error: Unknown capture format " << path << " (use .y4m or .raw)" << std::endl;
+        exit(1);
+    }
+    video.open(path, std::ios::binary);
+    if (!video.is_open()) {
+        std::cerr << "Error: Could not open file " << path << std::endl;
+        exit(1);
+    }
+
+    format = extension == ".y4m" ? Y4M : RAW;
+    if (format == Y4M) {
+        video << "YUV4MPEG2 W" << WIDTH << " H" << HEIGHT << " F" << rateNumerator << ":" << rateDenominator
+              << " Ip A1:1 Cmono\n";
+        luma.resize(WIDTH * HEIGHT);
+    }
+}
+
+void Capture::SetScreenshots(const std::string& directory, uint64_t every) {
+    screenshotDirectory = directory;
+    screenshotEvery = every;
+}
+
+void Capture::Start() {
+    if (running) return;
+    running = true;
+    thread = std::thread(&Capture::Run, this);
+}
+
+void Capture::Stop() {
+    running = false;
+    wake.notify_one();
+    if (thread.joinable()) {
+        thread.join();
+    }
+    if (video.is_open()) video.close();
+}
+
+void Capture::Submit(uint64_t number, const uint8_t* vram) {
+    bool screenshot = screenshotRequested.exchange(false) || (screenshotEvery && number % screenshotEvery == 0);
+    if (format == NONE && !screenshot) return;
+
+    int index;
+    if (!freeBuffers.Pop(index)) {
+        dropped++;
+        if (screenshot) screenshotRequested = true; // Take the next frame instead
+        return;
+    }
+    Buffer& buffer = pool[index];
+    buffer.number = number;
+    buffer.screenshot = screenshot;
+    std::memcpy(buffer.vram, vram, VideoFrame::SIZE);
+    filledBuffers.Push(index); // Cannot fail: it holds at most the POOL_SIZE buffers
+    wake.notify_one(); // Without the mutex: a missed wake-up only delays the encoder to its timeout
+}
+
+void Capture::Run() {
+    while (true) {
+        bool stopping = !running; // Read before the queue, so that a stop still writes every queued frame
+        int index;
+        if (filledBuffers.Pop(index)) {
+            Encode(pool[index]);
+            freeBuffers.Push(index);
+            continue;
+        }
+        if (stopping) break;
+        std::unique_lock<std::mutex> lock(wakeMutex);
+        wake.wait_for(lock, std::chrono::milliseconds(10));
+    }
+    video.flush();
+}
+
+void Capture::Encode(const Buffer& buffer) {
+    if (buffer.screenshot) WritePng(buffer);
+    if (format == NONE) return;
+
+    if (format == Y4M) {
+        // Keep the video in time: dropped frames show the last one written
+        if (lastNumber && buffer.number > lastNumber + 1) {
+            for (uint64_t i = lastNumber + 1; i < buffer.number; ++i) WriteY4mFrame(lastVram.data());
+        }
+        WriteY4mFrame(buffer.vram);
+        lastVram.assign(buffer.vram, buffer.vram + VideoFrame::SIZE);
+    } else {
+        uint8_t number[8];
+        for (int i = 0; i < 8; ++i) number[i] = (uint8_t)(buffer.number >> (8 * i));
+        video.write(reinterpret_cast<const char*>(number), sizeof(number));
+        video.write(reinterpret_cast<const char*>(buffer.vram), VideoFrame::SIZE);
+    }
+    lastNumber = buffer.number;
+    captured++;
+}
+
+void Capture::WriteY4mFrame(const uint8_t* vram) {
+    for (int y = 0; y < HEIGHT; ++y) {
+        for (int x = 0; x < WIDTH; ++x) {
+            luma[y * WIDTH + x] = Lit(vram, x, y) ? 255 : 0;
+        }
+    }
+    video << "FRAME\n";
+    video.write(reinterpret_cast<const char*>(luma.data()), luma.size());
+}
+
+void Capture::WritePng(const Buffer& buffer) {
+    // Rows of 1-bit pixels, each after a filter type byte of 0 (none)
+    std::vector<uint8_t> rows;
+    for (int y = 0; y < HEIGHT; ++y) {
+        rows.push_back(0);
+        for (int x = 0; x < WIDTH; x += 8) {
+            uint8_t byte = 0;
+            for (int bit = 0; bit < 8; ++bit) byte |= Lit(buffer.vram, x + bit, y) << (7 - bit);
+            rows.push_back(byte);
+        }
+    }
+
+    // zlib stream with one stored deflate block: the rows fit in its 65535 bytes
+    static_assert(WIDTH % 8 == 0 && HEIGHT * (1 + WIDTH / 8) <= 65535, "the rows must fit in one stored block");
+    std::vector<uint8_t> compressed = { 0x78, 0x01, 0x01 };
+    uint16_t length = (uint16_t)rows.size();
+    uint16_t inverse = (uint16_t)~length;
+    compressed.insert(compressed.end(), { (uint8_t)length, (uint8_t)(length >> 8), (uint8_t)inverse, (uint8_t)(inverse >> 8) });
+    compressed.insert(compressed.end(), rows.begin(), rows.end());
+    uint32_t a = 1, b = 0; // Adler-32
+    for (uint8_t byte : rows) {
+        a = (a + byte) % 65521;
+        b = (b + a) % 65521;
+    }
+    PutBig32(compressed, (b << 16) | a);
+
+    std::vector<uint8_t> header;
+    PutBig32(header, WIDTH);
+    PutBig32(header, HEIGHT);
+    header.insert(header.end(), { 1, 0, 0, 0, 0 }); // 1 bit per pixel, greyscale, deflate, no filters, no interlace
+
+    std::vector<uint8_t> png = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+    PutChunk(png, "IHDR", header);
+    PutChunk(png, "IDAT", compressed);
+    PutChunk(png, "IEND", std::vector<uint8_t>());
+
+    std::string path = (screenshotDirectory.empty() ? "." : screenshotDirectory) + "/screenshot-" + std::to_string(buffer.number) + ".png";
+    std::ofstream file(path, std::ios::binary);
+    if (!file.write(reinterpret_cast<const char*>(png.data()), png.size())) {
+        std::cerr << "Warning: Could not write screenshot " << path << std::endl;
+        return;
+    }
+    screenshots++;
+}
@@ -0,0 +1,84 @@
+#ifndef CAPTURE_H
+#define CAPTURE_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "frame.h"
+#include "spsc_queue.h"
+
+// Records finished frames without slowing the emulation. The emulation thread copies
+// each frame's packed 1bpp VRAM (7 KB) into a buffer from a fixed pool and queues it
+// for an encoder thread, which writes the video and the screenshots and then returns
+// the buffer. When the encoder falls behind and no buffer is free the frame is dropped
+// and counted: the emulation never waits for the disk.
+//
+// Video formats, by file extension:
+//   .y4m  YUV4MPEG2, 224x256 monochrome, upright; plays in ffmpeg and mpv. A dropped
+//         frame is filled by repeating the previous one so that the video keeps time.
+//   .raw  One record per frame: the frame number as 8 bytes little-endian, then the
+//         0x1C00 VRAM bytes as the machine has them. Lossless, for diffing runs.
+// Screenshots are 1-bit greyscale PNGs, screenshot-<frame>.png in the screenshot directory.
+class Capture {
+public:
+    Capture();
+    ~Capture();
+
+    // Call before Start()
+    void OpenVideo(const std::string& path, uint32_t rateNumerator, uint32_t rateDenominator);
+    void SetScreenshots(const std::string& directory, uint64_t every); // every 0: only on request
+    void Start();
+    void Stop(); // Write what is queued, then close the video
+
+    // Emulation thread: frame number as in VideoFrame, VRAM as in VideoFrame::vram
+    void Submit(uint64_t number, const uint8_t* vram);
+
+    // Any thread
+    void RequestScreenshot() { screenshotRequested = true; } // Of the next frame submitted
+    uint64_t Captured() const { return captured; } // Frames written to the video
+    uint64_t Dropped() const { return dropped; } // Frames lost because every buffer was in use
+    uint64_t Screenshots() const { return screenshots; }
+    bool Recording() const { return format != NONE; }
+
+private:
+    enum Format { NONE, Y4M, RAW };
+    static const int POOL_SIZE = 16; // Frames the encoder may fall behind before dropping
+
+    struct Buffer {
+        uint64_t number;
+        bool screenshot;
+        uint8_t vram[VideoFrame::SIZE];
+    };
+
+    void Run(); // Encoder thread main loop
+    void Encode(const Buffer& buffer);
+    void WriteY4mFrame(const uint8_t* vram);
+    void WritePng(const Buffer& buffer);
+
+    Buffer pool[POOL_SIZE];
+    SpscQueue<int, POOL_SIZE> freeBuffers; // Encoder to emulation thread
+    SpscQueue<int, POOL_SIZE> filledBuffers; // Emulation to encoder thread, in frame order
+    std::thread thread;
+    std::atomic<bool> running;
+    std::atomic<bool> screenshotRequested;
+    std::mutex wakeMutex; // Only for the encoder's wait, never taken by the emulation thread
+    std::condition_variable wake;
+    std::atomic<uint64_t> captured, dropped, screenshots;
+
+    Format format;
+    std::ofstream video;
+    std::string screenshotDirectory;
+    uint64_t screenshotEvery;
+
+    // Encoder thread only
+    uint64_t lastNumber; // Last frame written to the video, 0 before the first
+    std::vector<uint8_t> lastVram; // Its VRAM, repeated for dropped frames
+    std::vector<uint8_t> luma; // Y4M frame being written
+};
+
+#endif
@@ -1,9 +1,41 @@
 #include "cpu.h"
+#include "hle.h"
+#include "opcodes.h"
+#include <algorithm>
+#include <cstdio>
 #include <fstream>
+#include <iomanip>
 #include <iostream>
 #include <cstring>
 
-CPU8080::CPU8080() {
+#if defined(__GNUC__)
+#define ALWAYS_INLINE inline __attribute__((always_inline))
+#else
+#define ALWAYS_INLINE inline
+#endif
+
+static_assert(FLAGS_ALL == CPU8080::FLAG_MASK && FLAGS_CARRY == CPU8080::FLAG_CARRY,
+              "OpcodeFlags must use the PSW layout of the flags register");
+
+// Most cycles each superinstruction can take
+static constexpr int SequenceCycles(std::initializer_list<uint8_t> opcodes) {
+    int total = 0;
+    for (uint8_t opcode : opcodes) total += OPCODES[opcode].cycles + OPCODES[opcode].takenCycles;
+    return total;
+}
+
+#define SUPERINSTRUCTION_CYCLES(name, ...) SequenceCycles({ __VA_ARGS__ }),
+static constexpr uint8_t FUSED_CYCLES[] = {
+    SUPERINSTRUCTION_LIST(SUPERINSTRUCTION_CYCLES)
+};
+#undef SUPERINSTRUCTION_CYCLES
+
+CPU8080::CPU8080()
+    : io(&SpaceInvadersBus()), verbose(true), idleSkipping(true), cycleLimit(NO_CYCLE_LIMIT), hleHooks(0), sequenceProfile(nullptr), soundEvents(nullptr), trace(nullptr),
+#ifdef I8080_PROFILER
+      profiler(nullptr),
+#endif
+      superinstructions(nullptr) {
     Reset();
 }
 
@@ -11,54 +43,220 @@ void CPU8080::Reset() {
     A = B = C = D = E = H = L = 0;
     SP = 0x0000;
     PC = 0xFFFF;
-    flags = 0;
-    std::memset(memory, 0, sizeof(memory));
+    flags = FLAG_ALWAYS_ON;
+    port1 = port2 = 0;
+    shifter = ShiftRegister();
+    sound = SoundLatches();
+    watchdog = Watchdog();
+    interruptsEnabled = false;
+    halted = false;
+    cycles = frames = instructions = 0;
+    frameOffset = 0;
+    skippedCycles = 0;
+    memory.Clear();
+    ioCount = 0;
+    ResetIdleDetector();
 }
 
-void CPU8080::LoadProgram(const char* rom1, const char* rom2, const char* rom3, const char* rom4) {
-    // Load invaders.h into memory at 0x0000 - 0x07FF
-    std::ifstream file1(rom1, std::ios::binary);
-    if (!file1.is_open()) {
-        std::cerr << "Error: Could not open file " << rom1 << std::endl;
-        exit(1);
+void CPU8080::ResetIdleDetector() {
+    idle = false;
+    idleLoopPC = 0xFFFF;
+}
+
+void CPU8080::SaveState(CPUSnapshot& snapshot) const {
+    snapshot.A = A; snapshot.B = B; snapshot.C = C; snapshot.D = D;
+    snapshot.E = E; snapshot.H = H; snapshot.L = L;
+    snapshot.SP = SP;
+    snapshot.PC = PC;
+    snapshot.flags = flags;
+    snapshot.port1 = port1;
+    snapshot.port2 = port2;
+    snapshot.frameOffset = frameOffset;
+    snapshot.shifter = shifter;
+    snapshot.sound = sound;
+    snapshot.watchdog = watchdog;
+    snapshot.interruptsEnabled = interruptsEnabled;
+    snapshot.halted = halted;
+    snapshot.cycles = cycles;
+    snapshot.frames = frames;
+    snapshot.instructions = instructions;
+    snapshot.memory = memory; // Pages are shared copy-on-write
+}
+
+CPU8080 CPU8080::Fork() const {
+    CPU8080 child = *this; // Copying shares the memory pages copy-on-write
+    child.soundEvents = nullptr; // Only the machine itself is heard, not its branches
+    return child;
+}
+
+void CPU8080::LoadState(const CPUSnapshot& snapshot) {
+    A = snapshot.A; B = snapshot.B; C = snapshot.C; D = snapshot.D;
+    E = snapshot.E; H = snapshot.H; L = snapshot.L;
+    SP = snapshot.SP;
+    PC = snapshot.PC;
+    flags = snapshot.flags;
+    port1 = snapshot.port1;
+    port2 = snapshot.port2;
+    frameOffset = snapshot.frameOffset;
+    shifter = snapshot.shifter;
+    sound = snapshot.sound;
+    watchdog = snapshot.watchdog;
+    interruptsEnabled = snapshot.interruptsEnabled;
+    halted = snapshot.halted;
+    cycles = snapshot.cycles;
+    frames = snapshot.frames;
+    instructions = snapshot.instructions;
+    memory = snapshot.memory;
+    ResetIdleDetector();
+}
+
+int CPU8080::EnableHle(bool report) {
+    hleHooks = ValidateHleHooks(*this, report);
+
+    int enabled = 0;
+    for (uint32_t mask = hleHooks; mask; mask &= mask - 1) enabled++;
+    return enabled;
+}
+
+void CPU8080::EnableSuperinstructions(bool enable) {
+    if (enable) {
+        superinstructionTable = PredecodeSuperinstructions(memory, ROM_SIZE);
+        superinstructions = superinstructionTable->data();
+    } else {
+        superinstructionTable.reset();
+        superinstructions = nullptr;
     }
-    file1.read(reinterpret_cast<char*>(&memory[0x0000]), 0x0800);
-    file1.close();
+}
 
-    std::cout << "Loaded " << rom1 << " into memory at 0x0000 - 0x07FF" << std::endl;
+void CPU8080::GenerateInterrupt(int number) {
+    if (!interruptsEnabled) return;
 
-    // Load invaders.g into memory at 0x0800 - 0x0FFF
-    std::ifstream file2(rom2, std::ios::binary);
-    if (!file2.is_open()) {
-        std::cerr << "Error: Could not open file " << rom2 << std::endl;
-        exit(1);
+    if (halted) {
+        halted = false;
+        PC++; // Return after the HLT instruction
     }
-    file2.read(reinterpret_cast<char*>(&memory[0x0800]), 0x0800);
-    file2.close();
+    ResetIdleDetector();
 
-    std::cout << "Loaded " << rom2 << " into memory at 0x0800 - 0x0FFF" << std::endl;
+    // Same as RST number: push PC and jump to the interrupt vector
+    memory.Write(SP - 1, (PC >> 8) & 0xFF);
+    memory.Write(SP - 2, PC & 0xFF);
+    SP -= 2;
+    PC = number * 8;
+    interruptsEnabled = false;
+    PROFILE_INTERRUPT(number);
+}
 
-    // Load invaders.f into memory at 0x1000 - 0x17FF
-    std::ifstream file3(rom3, std::ios::binary);
-    if (!file3.is_open()) {
-        std::cerr << "Error: Could not open file " << rom3 << std::endl;
-        exit(1);
+void CPU8080::RunUntil(uint64_t targetCycle) {
+    while (cycles < targetCycle) {
+        Step(targetCycle);
+    }
+    cycleLimit = NO_CYCLE_LIMIT;
+}
+
+void CPU8080::Step(uint64_t limit) {
+    cycleLimit = limit;
+    if (halted) {
+        // Nothing can change before the next interrupt: credit the cycles and skip ahead
+        PROFILE_IDLE(limit - cycles);
+        skippedCycles += limit - cycles;
+        cycles = limit;
+        return;
+    }
+    if (idle) {
+        // Credit the whole loop iterations that end by limit; the last, partial one is
+        // interpreted so the interrupt arrives at the same instruction as without skipping
+        idle = false;
+        uint64_t skipped = (limit - cycles) / idleLoopCycles * idleLoopCycles;
+        if (skipped) {
+            PROFILE_IDLE(skipped);
+            skippedCycles += skipped;
+            cycles += skipped;
+            idleCycles += skipped; // The next detection measures one iteration again
+            return;
+        }
+    }
+    EmulateCycle();
+}
+
+void CPU8080::CheckIdleLoop() {
+    uint8_t registers[8] = { A, B, C, D, E, H, L, flags };
+
+    // Back at the same branch with the same registers, and nothing was written and no
+    // port was touched since: every iteration from now on is identical.
+    if (PC == idleLoopPC && SP == idleSP && memory.WriteCount() == idleWrites && ioCount == idleIO &&
+        std::memcmp(registers, idleRegisters, sizeof(registers)) == 0) {
+        idle = true;
+        idleLoopCycles = cycles - idleCycles;
+        return;
     }
-    file3.read(reinterpret_cast<char*>(&memory[0x1000]), 0x0800);
-    file3.close();
 
-    std::cout << "Loaded " << rom3 << " into memory at 0x1000 - 0x17FF" << std::endl;
+    idleLoopPC = PC;
+    idleSP = SP;
+    idleWrites = memory.WriteCount();
+    idleIO = ioCount;
+    idleCycles = cycles;
+    std::memcpy(idleRegisters, registers, sizeof(registers));
+}
 
-    // Load invaders.e into memory at 0x1800 - 0x1FFF
-    std::ifstream file4(rom4, std::ios::binary);
-    if (!file4.is_open()) {
-        std::cerr << "Error: Could not open file " << rom4 << std::endl;
+void CPU8080::RunFrame() {
+    RunFrameUntil(CYCLES_PER_FRAME);
+}
+
+void CPU8080::RunFrameUntil(uint64_t offset) {
+    uint64_t frameStart = frames * CYCLES_PER_FRAME;
+    const uint64_t middle = MID_SCREEN_CYCLE;
+
+    // Slices end wherever an instruction does, exactly as one call for the whole frame would
+    if (frameOffset < middle) {
+        RunUntil(frameStart + std::min(offset, middle));
+        if (offset < middle) {
+            frameOffset = offset;
+            return;
+        }
+        GenerateInterrupt(1); // Mid-screen interrupt (RST 1)
+    }
+
+    RunUntil(frameStart + offset);
+    frameOffset = offset;
+    if (offset < CYCLES_PER_FRAME) return;
+    GenerateInterrupt(2); // VBlank interrupt (RST 2)
+
+    frames++;
+    frameOffset = 0;
+}
+
+size_t CPU8080::LoadFile(const char* path, uint16_t address, size_t maxSize) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file.is_open()) {
+        std::cerr << "Error: Could not open file " << path << std::endl;
         exit(1);
     }
-    file4.read(reinterpret_cast<char*>(&memory[0x1800]), 0x0800);
-    file4.close();
 
-    std::cout << "Loaded " << rom4 << " into memory at 0x1800 - 0x1FFF" << std::endl;
+    std::vector<uint8_t> data(std::min(maxSize, (size_t)0x10000 - address));
+    file.read(reinterpret_cast<char*>(data.data()), data.size());
+    size_t size = file.gcount();
+    memory.Load(address, data.data(), size);
+    return size;
+}
+
+void CPU8080::LoadProgram(const char* rom1, const char* rom2, const char* rom3, const char* rom4) {
+    const char* roms[] = { rom1, rom2, rom3, rom4 };
+
+    // invaders.h, .g, .f and .e fill 0x0000 - 0x1FFF in 2KB pieces
+    for (int i = 0; i < 4; ++i) {
+        uint16_t address = i * 0x0800;
+        LoadFile(roms[i], address, 0x0800);
+        std::cout << "Loaded " << roms[i] << " into memory at 0x" << std::hex << std::uppercase << std::setw(4)
+                  << std::setfill('0') << address << " - 0x" << std::setw(4) << address + 0x07FF << std::dec
+                  << std::nouppercase << std::setfill(' ') << std::endl;
+    }
+
+    memory.SetReadOnly(0x0000, ROM_SIZE); // Writes to ROM are ignored by the hardware
+}
+
+void CPU8080::LoadRom(const uint8_t* data, size_t size) {
+    memory.Load(0x0000, data, std::min(size, (size_t)ROM_SIZE));
+    memory.SetReadOnly(0x0000, ROM_SIZE);
 }
 
 void CPU8080::PrintState() {
@@ -73,224 +271,272 @@ void CPU8080::PrintState() {
               << "PC: " << std::hex << PC << std::endl;
 }
 
-uint8_t CPU8080::InPort(uint8_t port) {
-    uint8_t result = 0;
-
-    switch(port) {
-        case 1:
-            result = port1;
-            break;
-        case 2:
-            result = port2;
-            break;
-        case 3:
-            result = (shiftRegister >> (8 - shiftOffset)) & 0xFF;
-            break;
-        default:
-            std::cerr << "Invalid input port: " << std::hex << (int)port << std::endl;
-            break;
+void CPU8080::Trace() {
+    char line[128];
+    std::snprintf(line, sizeof(line), "%04X  %-12s A=%02X BC=%02X%02X DE=%02X%02X HL=%02X%02X F=%02X SP=%04X %llu",
+                  PC, Disassemble(memory, PC).c_str(), A, B, C, D, E, H, L, flags, SP, (unsigned long long)cycles);
+    *trace << line;
+    uint8_t fused = superinstructions && PC < ROM_SIZE ? superinstructions[PC] : 0;
+    if (fused && (!interruptsEnabled || cycles + FUSED_CYCLES[fused - 1] <= cycleLimit)) {
+        *trace << "  [" << SUPERINSTRUCTIONS[fused - 1].name << "]";
     }
-    return result;
+    *trace << '\n';
 }
 
-void CPU8080::OutPort(uint8_t port, uint8_t value) {
-    switch(port) {
-        case 2:
-            // Graphic shift configuration
-            shiftOffset = value & 0x07;
-            break;
-        case 3:
-            // Sound configuration
-            if (value & 0x01) {
-                // Mix_PlayChannel(-1, sound, 0);
-                std::cout << "Shot Sound" << std::endl;
-            }
-            break;
-        case 4:
-            // Shift register configuration
-            shiftRegister = (shiftRegister >> 8) | (value << 8);
-            break;
-        case 5:
-            // Sound configuration
-            if (value & 0x01) {
-                // Mix_PlayChannel(-1, sound, 0);
-                std::cout << "UFO Sound" << std::endl;
-            }
-            break;
-        case 6:
-            // Video configuration
-            // Not implemented
-            break;
-        default:
-            std::cerr << "Invalid output port: " << std::hex << (int)port << std::endl;
-            break;
+// Port map of the Space Invaders board
+const IoBus<CPU8080>& CPU8080::SpaceInvadersBus() {
+    static const IoBus<CPU8080> bus = [] {
+        IoBus<CPU8080> map;
+        map.MapLatch<&CPU8080::port1>(1);
+        map.MapLatch<&CPU8080::port2>(2);
+        ShiftRegister::Attach<&CPU8080::shifter>(map, 2, 4, 3); // Offset out, data out, result in
+        SoundLatches::Attach<&CPU8080::sound>(map, 3, 5);
+        Watchdog::Attach<&CPU8080::watchdog>(map, 6);
+        return map;
+    }();
+    return bus;
+}
+
+// Sign, zero and parity flags of every result byte
+static const struct ZspTable {
+    uint8_t flags[256];
+    ZspTable() {
+        for (int value = 0; value < 256; ++value) {
+            int bits = 0;
+            for (int bit = 0; bit < 8; ++bit) bits += (value >> bit) & 1;
+            flags[value] = (value & CPU8080::FLAG_SIGN) | (value == 0 ? CPU8080::FLAG_ZERO : 0) |
+                           (bits % 2 == 0 ? CPU8080::FLAG_PARITY : 0);
+        }
     }
+} ZSP;
+
+ALWAYS_INLINE uint16_t CPU8080::ReadWord(uint16_t address) const {
+    return memory.Read(address) | (memory.Read(address + 1) << 8);
 }
 
-void CPU8080::RenderGraphics(Graphics& graphics) {
-    graphics.Clear();
+ALWAYS_INLINE void CPU8080::Push(uint16_t value) {
+    memory.Write(SP - 1, value >> 8);
+    memory.Write(SP - 2, value & 0xFF);
+    SP -= 2;
+}
 
-    // Render graphics here
-    // Space Invaders screen has a resolution of 224x256 pixels
+ALWAYS_INLINE uint16_t CPU8080::Pop() {
+    uint16_t value = ReadWord(SP);
+    SP += 2;
+    return value;
+}
 
-    for (int y = 0;  y < 256; ++y) {
-        for (int x = 0; x < 224; ++x) {
-            int byteIndex = 0x2400 + (x / 8) + (224 / 8); // Calculate byte index
-            int bitIndex = x % 8; // Calculate bit index
-            if (memory[byteIndex] & (1 << bitIndex)) { // if bit is set or active
-                graphics.DrawPixel(x, y);
-            } 
-        }
-    } 
+ALWAYS_INLINE bool CPU8080::Condition(uint8_t opcode) const {
+    static const uint8_t CONDITION_FLAGS[4] = { FLAG_ZERO, FLAG_CARRY, FLAG_PARITY, FLAG_SIGN };
+    bool set = flags & CONDITION_FLAGS[(opcode >> 4) & 0x03];
+    return (opcode & 0x08) ? set : !set;
+}
 
-    graphics.Update();
+ALWAYS_INLINE void CPU8080::Add(uint8_t value, uint8_t carry) {
+    uint16_t result = A + value + carry;
+    flags = ZSP.flags[result & 0xFF] | FLAG_ALWAYS_ON | (result >> 8) | ((A ^ value ^ result) & FLAG_AUX_CARRY);
+    A = result & 0xFF;
 }
 
-void CPU8080::EmulateCycle() {
-    uint8_t opcode = memory[PC]; // Fetch opcode from memory
+// The 8080 subtracts by adding the complement: the auxiliary carry is that addition's
+// carry out of bit 3, and the carry flag is the inverted carry out of bit 7
+ALWAYS_INLINE void CPU8080::Subtract(uint8_t value, uint8_t borrow) {
+    uint16_t result = A + (uint8_t)~value + !borrow;
+    flags = ZSP.flags[result & 0xFF] | FLAG_ALWAYS_ON | (~result >> 8 & FLAG_CARRY) |
+            ((A ^ ~value ^ result) & FLAG_AUX_CARRY);
+    A = result & 0xFF;
+}
+
+ALWAYS_INLINE void CPU8080::Compare(uint8_t value) {
+    uint8_t saved = A;
+    Subtract(value, 0);
+    A = saved;
+}
+
+ALWAYS_INLINE void CPU8080::And(uint8_t value) {
+    // ANA sets the auxiliary carry from bit 3 of the operands
+    uint8_t auxCarry = ((A | value) & 0x08) ? FLAG_AUX_CARRY : 0;
+    A &= value;
+    flags = ZSP.flags[A] | FLAG_ALWAYS_ON | auxCarry;
+}
+
+ALWAYS_INLINE void CPU8080::Xor(uint8_t value) {
+    A ^= value;
+    flags = ZSP.flags[A] | FLAG_ALWAYS_ON;
+}
+
+ALWAYS_INLINE void CPU8080::Or(uint8_t value) {
+    A |= value;
+    flags = ZSP.flags[A] | FLAG_ALWAYS_ON;
+}
+
+ALWAYS_INLINE uint8_t CPU8080::Increment(uint8_t value) {
+    uint8_t result = value + 1;
+    flags = (flags & FLAG_CARRY) | ZSP.flags[result] | FLAG_ALWAYS_ON | ((result & 0x0F) == 0 ? FLAG_AUX_CARRY : 0);
+    return result;
+}
+
+ALWAYS_INLINE uint8_t CPU8080::Decrement(uint8_t value) {
+    uint8_t result = value - 1;
+    flags = (flags & FLAG_CARRY) | ZSP.flags[result] | FLAG_ALWAYS_ON | ((result & 0x0F) != 0x0F ? FLAG_AUX_CARRY : 0);
+    return result;
+}
+
+ALWAYS_INLINE void CPU8080::DoubleAdd(uint16_t value) {
+    uint32_t result = ((H << 8) | L) + value;
+    H = (result >> 8) & 0xFF;
+    L = result & 0xFF;
+    flags = (flags & ~FLAG_CARRY) | (result >> 16);
+}
+
+ALWAYS_INLINE void CPU8080::DecimalAdjust() {
+    uint8_t correction = 0;
+    uint8_t carry = flags & FLAG_CARRY;
+    if ((flags & FLAG_AUX_CARRY) || (A & 0x0F) > 9) {
+        correction = 0x06;
+    }
+    if (carry || (A >> 4) > 9 || ((A >> 4) >= 9 && (A & 0x0F) > 9)) {
+        correction |= 0x60;
+        carry = FLAG_CARRY;
+    }
+    Add(correction, 0);
+    flags = (flags & ~FLAG_CARRY) | carry;
+}
+
+ALWAYS_INLINE void CPU8080::Execute(uint8_t opcode) {
+    uint16_t instructionPC = PC;
+    PROFILE_INSTRUCTION_BEGIN();
     PC++; // Increment program counter
+    cycles += OPCODES[opcode].cycles;
+    instructions++;
 
     switch(opcode) {
         case 0x00: // NOP
             break;
         case 0x01: // LXI B, D16
-            C = memory[PC];
-            B = memory[PC + 1];
+            C = memory.Read(PC);
+            B = memory.Read(PC + 1);
             PC += 2;
             break;
         case 0x02: // STAX B
-            memory[(B << 8) | C] = A;
+            memory.Write((B << 8) | C, A);
             break;
         case 0x03: // INX B
             C++;
             if (C == 0) B++;
             break;
         case 0x04: // INR B
-            B++;
+            B = Increment(B);
             break;
         case 0x05: // DCR B
-            B--;
+            B = Decrement(B);
             break;
         case 0x06: // MVI B, D8
-            B = memory[PC];
+            B = memory.Read(PC);
             PC++;
             break;
         case 0x07: // RLC
-            flags = (A & 0x80) ? 1 : 0;
+            flags = (flags & ~FLAG_CARRY) | (A >> 7);
             A = (A << 1) | (A >> 7);
             break;
         case 0x08: // -
             break;
         case 0x09: // DAD B
-            {
-                uint16_t HL = (H << 8) | L;
-                uint16_t BC = (B << 8) | C;
-                uint32_t result = HL + BC;
-                H = (result >> 8) & 0xFF;
-                L = result & 0xFF;
-                flags = (result > 0xFFFF) ? 1 : 0;
-            }
+            DoubleAdd((B << 8) | C);
             break;
         case 0x0A: // LDAX B
-            A = memory[(B << 8) | C];
+            A = memory.Read((B << 8) | C);
             break;
         case 0x0B: // DCX B
             C--;
             if (C == 0xFF) B--;
             break;
         case 0x0C: // INR C
-            C++;
+            C = Increment(C);
             break;
         case 0x0D: // DCR C
-            C--;
+            C = Decrement(C);
             break;
         case 0x0E: // MVI C, D8
-            C = memory[PC];
+            C = memory.Read(PC);
             PC++;
             break;
         case 0x0F: // RRC
-            flags = (A & 0x01) ? 1 : 0;
+            flags = (flags & ~FLAG_CARRY) | (A & 0x01);
             A = (A >> 1) | (A << 7);
             break;
         case 0x10: // -
             break;
         case 0x11: // LXI D, D16
-            E = memory[PC];
-            D = memory[PC + 1];
+            E = memory.Read(PC);
+            D = memory.Read(PC + 1);
             PC += 2;
             break;
         case 0x12: // STAX D
-            memory[(D << 8) | E] = A;
+            memory.Write((D << 8) | E, A);
             break;
         case 0x13: // INX D
             E++;
             if (E == 0) D++;
             break;
         case 0x14: // INR D
-            D++;
+            D = Increment(D);
             break;
         case 0x15: // DCR D
-            D--;
+            D = Decrement(D);
             break;
         case 0x16: // MVI D, D8
-            D = memory[PC];
+            D = memory.Read(PC);
             PC++;
             break;
         case 0x17: // RAL
             {
-                uint8_t carry = flags;
-                flags = (A & 0x80) ? 1 : 0;
+                uint8_t carry = flags & FLAG_CARRY;
+                flags = (flags & ~FLAG_CARRY) | (A >> 7);
                 A = (A << 1) | carry;
             }
             break;
         case 0x18: // -
             break;
         case 0x19: // DAD D
-            {
-                uint16_t HL = (H << 8) | L;
-                uint16_t DE = (D << 8) | E;
-                uint32_t result = HL + DE;
-                H = (result >> 8) & 0xFF;
-                L = result & 0xFF;
-                flags = (result > 0xFFFF) ? 1 : 0;
-            }
+            DoubleAdd((D << 8) | E);
             break;
         case 0x1A: // LDAX D
-            A = memory[(D << 8) | E];
+            A = memory.Read((D << 8) | E);
             break;
         case 0x1B: // DCX D
             E--;
             if (E == 0xFF) D--;
             break;
         case 0x1C: // INR E
-            E++;
+            E = Increment(E);
             break;
         case 0x1D: // DCR E
-            E--;
+            E = Decrement(E);
             break;
         case 0x1E: // MVI E, D8
-            E = memory[PC];
+            E = memory.Read(PC);
             PC++;
             break;
         case 0x1F: // RAR
             {
-                uint8_t carry = flags;
-                flags = (A & 0x01) ? 1 : 0;
+                uint8_t carry = flags & FLAG_CARRY;
+                flags = (flags & ~FLAG_CARRY) | (A & 0x01);
                 A = (A >> 1) | (carry << 7);
             }
             break;
         case 0x20: // -
             break;
         case 0x21: // LXI H, D16
-            L = memory[PC];
-            H = memory[PC + 1];
+            L = memory.Read(PC);
+            H = memory.Read(PC + 1);
             PC += 2;
             break;
         case 0x22: // SHLD adr
             {
-                uint16_t adr = memory[PC] | (memory[PC + 1] << 8);
-                memory[adr] = L;
-                memory[adr + 1] = H;
+                uint16_t adr = memory.Read(PC) | (memory.Read(PC + 1) << 8);
+                memory.Write(adr, L);
+                memory.Write(adr + 1, H);
                 PC += 2;
             }
             break;
@@ -299,43 +545,28 @@ void CPU8080::EmulateCycle() {
             if (L == 0) H++;
             break;
         case 0x24: // INR H
-            H++;
+            H = Increment(H);
             break;
         case 0x25: // DCR H
-            H--;
+            H = Decrement(H);
             break;
         case 0x26: // MVI H, D8
-            H = memory[PC];
+            H = memory.Read(PC);
             PC++;
             break;
         case 0x27: // DAA
-            {
-                uint16_t result = A;
-                if ((result & 0x0F) > 9 || (flags & 0x10)) result += 6;
-                if ((result & 0xF0) > 0x90 || (flags & 0x10)) {
-                    result += 0x60;
-                    flags |= 0x10;
-                }
-                A = result & 0xFF;
-                flags &= 0x01;
-            }
+            DecimalAdjust();
             break;
         case 0x28: // -
             break;
         case 0x29: // DAD H
-            {
-                uint16_t HL = (H << 8) | L;
-                uint32_t result = HL + HL;
-                H = (result >> 8) & 0xFF;
-                L = result & 0xFF;
-                flags = (result > 0xFFFF) ? 1 : 0;
-            }
+            DoubleAdd((H << 8) | L);
             break;
         case 0x2A: // LHLD adr
             {
-                uint16_t adr = memory[PC] | (memory[PC + 1] << 8);
-                L = memory[adr];
-                H = memory[adr + 1];
+                uint16_t adr = memory.Read(PC) | (memory.Read(PC + 1) << 8);
+                L = memory.Read(adr);
+                H = memory.Read(adr + 1);
                 PC += 2;
             }
             break;
@@ -344,13 +575,13 @@ void CPU8080::EmulateCycle() {
             if (L == 0xFF) H--;
             break;
         case 0x2C: // INR L
-            L++;
+            L = Increment(L);
             break;
         case 0x2D: // DCR L
-            L--;
+            L = Decrement(L);
             break;
         case 0x2E: // MVI L, D8
-            L = memory[PC];
+            L = memory.Read(PC);
             PC++;
             break;
         case 0x2F: // CMA
@@ -359,13 +590,13 @@ void CPU8080::EmulateCycle() {
         case 0x30: // -
             break;
         case 0x31: // LXI SP, D16
-            SP = memory[PC] | (memory[PC + 1] << 8);
+            SP = memory.Read(PC) | (memory.Read(PC + 1) << 8);
             PC += 2;
             break;
         case 0x32: // STA adr
             {
-                uint16_t adr = memory[PC] | (memory[PC + 1] << 8);
-                memory[adr] = A;
+                uint16_t adr = memory.Read(PC) | (memory.Read(PC + 1) << 8);
+                memory.Write(adr, A);
                 PC += 2;
             }
             break;
@@ -375,40 +606,34 @@ void CPU8080::EmulateCycle() {
         case 0x34: // INR M
             {
                 uint16_t adr = (H << 8) | L;
-                memory[adr]++;
+                memory.Write(adr, Increment(memory.Read(adr)));
             }
             break;
         case 0x35: // DCR M
             {
                 uint16_t adr = (H << 8) | L;
-                memory[adr]--;
+                memory.Write(adr, Decrement(memory.Read(adr)));
             }
             break;
         case 0x36: // MVI M, D8
             {
                 uint16_t adr = (H << 8) | L;
-                memory[adr] = memory[PC];
+                memory.Write(adr, memory.Read(PC));
                 PC++;
             }
             break;
         case 0x37: // STC
-            flags |= 0x01;
+            flags |= FLAG_CARRY;
             break;
         case 0x38: // -
             break;
         case 0x39: // DAD SP
-            {
-                uint16_t HL = (H << 8) | L;
-                uint32_t result = HL + SP;
-                H = (result >> 8) & 0xFF;
-                L = result & 0xFF;
-                flags = (result > 0xFFFF) ? 1 : 0;
-            }
+            DoubleAdd(SP);
             break;
         case 0x3A: // LDA adr
             {
-                uint16_t adr = memory[PC] | (memory[PC + 1] << 8);
-                A = memory[adr];
+                uint16_t adr = memory.Read(PC) | (memory.Read(PC + 1) << 8);
+                A = memory.Read(adr);
                 PC += 2;
             }
             break;
@@ -416,17 +641,17 @@ void CPU8080::EmulateCycle() {
             SP--;
             break;
         case 0x3C: // INR A
-            A++;
+            A = Increment(A);
             break;
         case 0x3D: // DCR A
-            A--;
+            A = Decrement(A);
             break;
         case 0x3E: // MVI A, D8
-            A = memory[PC];
+            A = memory.Read(PC);
             PC++;
             break;
         case 0x3F: // CMC
-            flags ^= 0x01;
+            flags ^= FLAG_CARRY;
             break;
         case 0x40: // MOV B, B
             B = B;
@@ -449,7 +674,7 @@ void CPU8080::EmulateCycle() {
         case 0x46: // MOV B, M
             {
                 uint16_t adr = (H << 8) | L;
-                B = memory[adr];
+                B = memory.Read(adr);
             }
             break;
         case 0x47: // MOV B, A
@@ -476,7 +701,7 @@ void CPU8080::EmulateCycle() {
         case 0x4E: // MOV C, M
             {
                 uint16_t adr = (H << 8) | L;
-                C = memory[adr];
+                C = memory.Read(adr);
             }
             break;
         case 0x4F: // MOV C, A
@@ -503,7 +728,7 @@ void CPU8080::EmulateCycle() {
         case 0x56: // MOV D, M
             {
                 uint16_t adr = (H << 8) | L;
-                D = memory[adr];
+                D = memory.Read(adr);
             }
             break;
         case 0x57: // MOV D, A
@@ -530,7 +755,7 @@ void CPU8080::EmulateCycle() {
         case 0x5E: // MOV E, M
             {
                 uint16_t adr = (H << 8) | L;
-                E = memory[adr];
+                E = memory.Read(adr);
             }
             break;
         case 0x5F: // MOV E, A
@@ -557,7 +782,7 @@ void CPU8080::EmulateCycle() {
         case 0x66: // MOV H, M
             {
                 uint16_t adr = (H << 8) | L;
-                H = memory[adr];
+                H = memory.Read(adr);
             }
             break;
         case 0x67: // MOV H, A
@@ -584,7 +809,7 @@ void CPU8080::EmulateCycle() {
         case 0x6E: // MOV L, M
             {
                 uint16_t adr = (H << 8) | L;
-                L = memory[adr];
+                L = memory.Read(adr);
             }
             break;
         case 0x6F: // MOV L, A
@@ -593,46 +818,48 @@ void CPU8080::EmulateCycle() {
         case 0x70: // MOV M, B
             {
                 uint16_t adr = (H << 8) | L;
-                memory[adr] = B;
+                memory.Write(adr, B);
             }
             break;
         case 0x71: // MOV M, C
             {
                 uint16_t adr = (H << 8) | L;
-                memory[adr] = C;
+                memory.Write(adr, C);
             }
             break;
         case 0x72: // MOV M, D
             {
                 uint16_t adr = (H << 8) | L;
-                memory[adr] = D;
+                memory.Write(adr, D);
             }
             break;
         case 0x73: // MOV M, E
             {
                 uint16_t adr = (H << 8) | L;
-                memory[adr] = E;
+                memory.Write(adr, E);
             }
             break;
         case 0x74: // MOV M, H
             {
                 uint16_t adr = (H << 8) | L;
-                memory[adr] = H;
+                memory.Write(adr, H);
             }
             break;
         case 0x75: // MOV M, L
             {
                 uint16_t adr = (H << 8) | L;
-                memory[adr] = L;
+                memory.Write(adr, L);
             }
             break;
         case 0x76: // HLT
-            std::exit(0);
+            // Park on the HLT until an interrupt; RunUntil skips the idle time
+            halted = true;
+            PC = instructionPC;
             break;
         case 0x77: // MOV M, A
             {
                 uint16_t adr = (H << 8) | L;
-                memory[adr] = A;
+                memory.Write(adr, A);
             }
             break;
         case 0x78: // MOV A, B
@@ -656,611 +883,407 @@ void CPU8080::EmulateCycle() {
         case 0x7E: // MOV A, M
             {
                 uint16_t adr = (H << 8) | L;
-                A = memory[adr];
+                A = memory.Read(adr);
             }
             break;
         case 0x7F: // MOV A, A
             A = A;
             break;
         case 0x80: // ADD B
-            {
-                uint16_t result = A + B;
-                A = result & 0xFF;
-                flags = (result > 0xFF) ? 1 : 0;
-            }
+            Add(B, 0);
             break;
         case 0x81: // ADD C
-            {
-                uint16_t result = A + C;
-                A = result & 0xFF;
-                flags = (result > 0xFF) ? 1 : 0;
-            }
+            Add(C, 0);
             break;
         case 0x82: // ADD D
-            {
-                uint16_t result = A + D;
-                A = result & 0xFF;
-                flags = (result > 0xFF) ? 1 : 0;
-            }
+            Add(D, 0);
             break;
         case 0x83: // ADD E
-            {
-                uint16_t result = A + E;
-                A = result & 0xFF;
-                flags = (result > 0xFF) ? 1 : 0;
-            }
+            Add(E, 0);
             break;
         case 0x84: // ADD H
-            {
-                uint16_t result = A + H;
-                A = result & 0xFF;
-                flags = (result > 0xFF) ? 1 : 0;
-            }
+            Add(H, 0);
             break;
         case 0x85: // ADD L
-            {
-                uint16_t result = A + L;
-                A = result & 0xFF;
-                flags = (result > 0xFF) ? 1 : 0;
-            }
+            Add(L, 0);
             break;
         case 0x86: // ADD M
-            {
-                uint16_t adr = (H << 8) | L;
-                uint16_t result = A + memory[adr];
-                A = result & 0xFF;
-                flags = (result > 0xFF) ? 1 : 0;
-            }
+            Add(memory.Read((H << 8) | L), 0);
             break;
         case 0x87: // ADD A
-            {
-                uint16_t result = A + A;
-                A = result & 0xFF;
-                flags = (result > 0xFF) ? 1 : 0;
-            }
+            Add(A, 0);
             break;
         case 0x88: // ADC B
-            {
-                uint16_t result = A + B + flags;
-                A = result & 0xFF;
-                flags = (result > 0xFF) ? 1 : 0;
-            }
+            Add(B, flags & FLAG_CARRY);
             break;
         case 0x89: // ADC C
-            {
-                uint16_t result = A + C + flags;
-                A = result & 0xFF;
-                flags = (result > 0xFF) ? 1 : 0;
-            }
+            Add(C, flags & FLAG_CARRY);
             break;
         case 0x8A: // ADC D
-            {
-                uint16_t result = A + D + flags;
-                A = result & 0xFF;
-                flags = (result > 0xFF) ? 1 : 0;
-            }
+            Add(D, flags & FLAG_CARRY);
             break;
         case 0x8B: // ADC E
-            {
-                uint16_t result = A + E + flags;
-                A = result & 0xFF;
-                flags = (result > 0xFF) ? 1 : 0;
-            }
+            Add(E, flags & FLAG_CARRY);
             break;
         case 0x8C: // ADC H
-            {
-                uint16_t result = A + H + flags;
-                A = result & 0xFF;
-                flags = (result > 0xFF) ? 1 : 0;
-            }
+            Add(H, flags & FLAG_CARRY);
             break;
         case 0x8D: // ADC L
-            {
-                uint16_t result = A + L + flags;
-                A = result & 0xFF;
-                flags = (result > 0xFF) ? 1 : 0;
-            }
+            Add(L, flags & FLAG_CARRY);
             break;
         case 0x8E: // ADC M
-            {
-                uint16_t adr = (H << 8) | L;
-                uint16_t result = A + memory[adr] + flags;
-                A = result & 0xFF;
-                flags = (result > 0xFF) ? 1 : 0;
-            }
+            Add(memory.Read((H << 8) | L), flags & FLAG_CARRY);
             break;
         case 0x8F: // ADC A
-            {
-                uint16_t result = A + A + flags;
-                A = result & 0xFF;
-                flags = (result > 0xFF) ? 1 : 0;
-            }
+            Add(A, flags & FLAG_CARRY);
             break;
         case 0x90: // SUB B
-            {
-                uint16_t result = A - B;
-                A = result & 0xFF;
-                flags = (result > 0xFF) ? 1 : 0;
-            }
+            Subtract(B, 0);
             break;
         case 0x91: // SUB C
-            {
-                uint16_t result = A - C;
-                A = result & 0xFF;
-                flags = (result > 0xFF) ? 1 : 0;
-            }
+            Subtract(C, 0);
             break;
         case 0x92: // SUB D
-            {
-                uint16_t result = A - D;
-                A = result & 0xFF;
-                flags = (result > 0xFF) ? 1 : 0;
-            }
+            Subtract(D, 0);
             break;
         case 0x93: // SUB E
-            {
-                uint16_t result = A - E;
-                A = result & 0xFF;
-                flags = (result > 0xFF) ? 1 : 0;
-            }
+            Subtract(E, 0);
             break;
         case 0x94: // SUB H
-            {
-                uint16_t result = A - H;
-                A = result & 0xFF;
-                flags = (result > 0xFF) ? 1 : 0;
-            }
+            Subtract(H, 0);
             break;
         case 0x95: // SUB L
-            {
-                uint16_t result = A - L;
-                A = result & 0xFF;
-                flags = (result > 0xFF) ? 1 : 0;
-            }
+            Subtract(L, 0);
             break;
         case 0x96: // SUB M
-            {
-                uint16_t adr = (H << 8) | L;
-                uint16_t result = A - memory[adr];
-                A = result & 0xFF;
-                flags = (result > 0xFF) ? 1 : 0;
-            }
+            Subtract(memory.Read((H << 8) | L), 0);
             break;
         case 0x97: // SUB A
-            {
-                uint16_t result = A - A;
-                A = result & 0xFF;
-                flags = (result > 0xFF) ? 1 : 0;
-            }
+            Subtract(A, 0);
             break;
         case 0x98: // SBB B
-            {
-                uint16_t result = A - B - flags;
-                A = result & 0xFF;
-                flags = (result > 0xFF) ? 1 : 0;
-            }
+            Subtract(B, flags & FLAG_CARRY);
             break;
         case 0x99: // SBB C
-            {
-                uint16_t result = A - C - flags;
-                A = result & 0xFF;
-                flags = (result > 0xFF) ? 1 : 0;
-            }
+            Subtract(C, flags & FLAG_CARRY);
             break;
         case 0x9A: // SBB D
-            {
-                uint16_t result = A - D - flags;
-                A = result & 0xFF;
-                flags = (result > 0xFF) ? 1 : 0;
-            }
+            Subtract(D, flags & FLAG_CARRY);
             break;
         case 0x9B: // SBB E
-            {
-                uint16_t result = A - E - flags;
-                A = result & 0xFF;
-                flags = (result > 0xFF) ? 1 : 0;
-            }
+            Subtract(E, flags & FLAG_CARRY);
             break;
         case 0x9C: // SBB H
-            {
-                uint16_t result = A - H - flags;
-                A = result & 0xFF;
-                flags = (result > 0xFF) ? 1 : 0;
-            }
+            Subtract(H, flags & FLAG_CARRY);
             break;
         case 0x9D: // SBB L
-            {
-                uint16_t result = A - L - flags;
-                A = result & 0xFF;
-                flags = (result > 0xFF) ? 1 : 0;
-            }
+            Subtract(L, flags & FLAG_CARRY);
             break;
         case 0x9E: // SBB M
-            {
-                uint16_t adr = (H << 8) | L;
-                uint16_t result = A - memory[adr] - flags;
-                A = result & 0xFF;
-                flags = (result > 0xFF) ? 1 : 0;
-            }
+            Subtract(memory.Read((H << 8) | L), flags & FLAG_CARRY);
             break;
         case 0x9F: // SBB A
-            {
-                uint16_t result = A - A - flags;
-                A = result & 0xFF;
-                flags = (result > 0xFF) ? 1 : 0;
-            }
+            Subtract(A, flags & FLAG_CARRY);
             break;
         case 0xA0: // ANA B
-            A &= B;
-            flags = (A == 0) ? 1 : 0;
+            And(B);
             break;
         case 0xA1: // ANA C
-            A &= C;
-            flags = (A == 0) ? 1 : 0;
+            And(C);
             break;
         case 0xA2: // ANA D
-            A &= D;
-            flags = (A == 0) ? 1 : 0;
+            And(D);
             break;
         case 0xA3: // ANA E
-            A &= E;
-            flags = (A == 0) ? 1 : 0;
+            And(E);
             break;
         case 0xA4: // ANA H
-            A &= H;
-            flags = (A == 0) ? 1 : 0;
+            And(H);
             break;
         case 0xA5: // ANA L
-            A &= L;
-            flags = (A == 0) ? 1 : 0;
+            And(L);
             break;
         case 0xA6: // ANA M
-            {
-                uint16_t adr = (H << 8) | L;
-                A &= memory[adr];
-                flags = (A == 0) ? 1 : 0;
-            }
+            And(memory.Read((H << 8) | L));
             break;
         case 0xA7: // ANA A
-            A &= A;
-            flags = (A == 0) ? 1 : 0;
+            And(A);
             break;
         case 0xA8: // XRA B
-            A ^= B;
-            flags = (A == 0) ? 1 : 0;
+            Xor(B);
             break;
         case 0xA9: // XRA C
-            A ^= C;
-            flags = (A == 0) ? 1 : 0;
+            Xor(C);
             break;
         case 0xAA: // XRA D
-            A ^= D;
-            flags = (A == 0) ? 1 : 0;
+            Xor(D);
             break;
         case 0xAB: // XRA E
-            A ^= E;
-            flags = (A == 0) ? 1 : 0;
+            Xor(E);
             break;
         case 0xAC: // XRA H
-            A ^= H;
-            flags = (A == 0) ? 1 : 0;
+            Xor(H);
             break;
         case 0xAD: // XRA L
-            A ^= L;
-            flags = (A == 0) ? 1 : 0;
+            Xor(L);
             break;
         case 0xAE: // XRA M
-            {
-                uint16_t adr = (H << 8) | L;
-                A ^= memory[adr];
-                flags = (A == 0) ? 1 : 0;
-            }
+            Xor(memory.Read((H << 8) | L));
             break;
         case 0xAF: // XRA A
-            A ^= A;
-            flags = (A == 0) ? 1 : 0;
+            Xor(A);
             break;
         case 0xB0: // ORA B
-            A |= B;
-            flags = (A == 0) ? 1 : 0;
+            Or(B);
             break;
         case 0xB1: // ORA C
-            A |= C;
-            flags = (A == 0) ? 1 : 0;
+            Or(C);
             break;
         case 0xB2: // ORA D
-            A |= D;
-            flags = (A == 0) ? 1 : 0;
+            Or(D);
             break;
         case 0xB3: // ORA E
-            A |= E;
-            flags = (A == 0) ? 1 : 0;
+            Or(E);
             break;
         case 0xB4: // ORA H
-            A |= H;
-            flags = (A == 0) ? 1 : 0;
+            Or(H);
             break;
         case 0xB5: // ORA L
-            A |= L;
-            flags = (A == 0) ? 1 : 0;
+            Or(L);
             break;
         case 0xB6: // ORA M
-            {
-                uint16_t adr = (H << 8) | L;
-                A |= memory[adr];
-                flags = (A == 0) ? 1 : 0;
-            }
+            Or(memory.Read((H << 8) | L));
             break;
         case 0xB7: // ORA A
-            A |= A;
-            flags = (A == 0) ? 1 : 0;
+            Or(A);
             break;
         case 0xB8: // CMP B
-            {
-                uint16_t result = A - B;
-                flags = (result > 0xFF) ? 1 : 0;
-            }
+            Compare(B);
             break;
         case 0xB9: // CMP C
-            {
-                uint16_t result = A - C;
-                flags = (result > 0xFF) ? 1 : 0;
-            }
+            Compare(C);
             break;
         case 0xBA: // CMP D
-            {
-                uint16_t result = A - D;
-                flags = (result > 0xFF) ? 1 : 0;
-            }
+            Compare(D);
             break;
         case 0xBB: // CMP E
-            {
-                uint16_t result = A - E;
-                flags = (result > 0xFF) ? 1 : 0;
-            }
+            Compare(E);
             break;
         case 0xBC: // CMP H
-            {
-                uint16_t result = A - H;
-                flags = (result > 0xFF) ? 1 : 0;
-            }
+            Compare(H);
             break;
         case 0xBD: // CMP L
-            {
-                uint16_t result = A - L;
-                flags = (result > 0xFF) ? 1 : 0;
-            }
+            Compare(L);
             break;
         case 0xBE: // CMP M
-            {
-                uint16_t adr = (H << 8) | L;
-                uint16_t result = A - memory[adr];
-                flags = (result > 0xFF) ? 1 : 0;
-            }
+            Compare(memory.Read((H << 8) | L));
             break;
         case 0xBF: // CMP A
-            {
-                uint16_t result = A - A;
-                flags = (result > 0xFF) ? 1 : 0;
-            }
+            Compare(A);
             break;
         case 0xC0: // RNZ
-            if (!(flags & 0x01)) {
-                PC = memory[SP] | (memory[SP + 1] << 8);
-                SP += 2;
+            if (Condition(opcode)) {
+                PC = Pop();
+                cycles += OPCODES[opcode].takenCycles; // Taken
             }
             break;
         case 0xC1: // POP B
-            C = memory[SP];
-            B = memory[SP + 1];
+            C = memory.Read(SP);
+            B = memory.Read(SP + 1);
             SP += 2;
             break;
         case 0xC2: // JNZ adr
-            if (!(flags & 0x01)) {
-                PC = memory[PC] | (memory[PC + 1] << 8);
+            if (Condition(opcode)) {
+                PC = ReadWord(PC);
             } else {
                 PC += 2;
             }
             break;
         case 0xC3: // JMP adr
-            PC = memory[PC] | (memory[PC + 1] << 8);
+            PC = memory.Read(PC) | (memory.Read(PC + 1) << 8);
+            if (hleHooks) RunHleHook(*this, hleHooks);
             break;
         case 0xC4: // CNZ adr
-            if (!(flags & 0x01)) {
-                memory[SP - 1] = (PC >> 8) & 0xFF;
-                memory[SP - 2] = PC & 0xFF;
-                SP -= 2;
-                PC = memory[PC] | (memory[PC + 1] << 8);
+            if (Condition(opcode)) {
+                Push(PC + 2);
+                PC = ReadWord(PC);
+                cycles += OPCODES[opcode].takenCycles; // Taken
             } else {
                 PC += 2;
             }
             break;
         case 0xC5: // PUSH B
-            memory[SP - 1] = B;
-            memory[SP - 2] = C;
+            memory.Write(SP - 1, B);
+            memory.Write(SP - 2, C);
             SP -= 2;
             break;
         case 0xC6: // ADI D8
-            {
-                uint16_t result = A + memory[PC];
-                A = result & 0xFF;
-                flags = (result > 0xFF) ? 1 : 0;
-                PC++;
-            }
+            Add(memory.Read(PC), 0);
+            PC++;
             break;
         case 0xC7: // RST 0
-            memory[SP - 1] = (PC >> 8) & 0xFF;
-            memory[SP - 2] = PC & 0xFF;
+            memory.Write(SP - 1, (PC >> 8) & 0xFF);
+            memory.Write(SP - 2, PC & 0xFF);
             SP -= 2;
             PC = 0x00;
             break;
         case 0xC8: // RZ
-            if (flags & 0x01) {
-                PC = memory[SP] | (memory[SP + 1] << 8);
-                SP += 2;
+            if (Condition(opcode)) {
+                PC = Pop();
+                cycles += OPCODES[opcode].takenCycles; // Taken
             }
             break;
         case 0xC9: // RET
-            PC = memory[SP] | (memory[SP + 1] << 8);
+            PC = memory.Read(SP) | (memory.Read(SP + 1) << 8);
             SP += 2;
             break;
         case 0xCA: // JZ adr
-            if (flags & 0x01) {
-                PC = memory[PC] | (memory[PC + 1] << 8);
+            if (Condition(opcode)) {
+                PC = ReadWord(PC);
             } else {
                 PC += 2;
             }
             break;
-        case 0xCB: // -
+        case 0xCB: // JMP adr (undocumented)
+            PC = ReadWord(PC);
             break;
         case 0xCC: // CZ adr
-            if (flags & 0x01) {
-                memory[SP - 1] = (PC >> 8) & 0xFF;
-                memory[SP - 2] = PC & 0xFF;
-                SP -= 2;
-                PC = memory[PC] | (memory[PC + 1] << 8);
+            if (Condition(opcode)) {
+                Push(PC + 2);
+                PC = ReadWord(PC);
+                cycles += OPCODES[opcode].takenCycles; // Taken
             } else {
                 PC += 2;
             }
             break;
         case 0xCD: // CALL adr
-            memory[SP - 1] = (PC >> 8) & 0xFF;
-            memory[SP - 2] = PC & 0xFF;
-            SP -= 2;
-            PC = memory[PC] | (memory[PC + 1] << 8);
+            Push(PC + 2);
+            PC = ReadWord(PC);
+            if (hleHooks) RunHleHook(*this, hleHooks);
             break;
         case 0xCE: // ACI D8
-            {
-                uint16_t result = A + memory[PC] + flags;
-                A = result & 0xFF;
-                flags = (result > 0xFF) ? 1 : 0;
-                PC++;
-            }
+            Add(memory.Read(PC), flags & FLAG_CARRY);
+            PC++;
             break;
         case 0xCF: // RST 1
-            memory[SP - 1] = (PC >> 8) & 0xFF;
-            memory[SP - 2] = PC & 0xFF;
+            memory.Write(SP - 1, (PC >> 8) & 0xFF);
+            memory.Write(SP - 2, PC & 0xFF);
             SP -= 2;
             PC = 0x08;
             break;
         case 0xD0: // RNC
-            if (!(flags & 0x10)) {
-                PC = memory[SP] | (memory[SP + 1] << 8);
-                SP += 2;
+            if (Condition(opcode)) {
+                PC = Pop();
+                cycles += OPCODES[opcode].takenCycles; // Taken
             }
             break;
         case 0xD1: // POP D
-            E = memory[SP];
-            D = memory[SP + 1];
+            E = memory.Read(SP);
+            D = memory.Read(SP + 1);
             SP += 2;
             break;
         case 0xD2: // JNC adr
-            if (!(flags & 0x10)) {
-                PC = memory[PC] | (memory[PC + 1] << 8);
+            if (Condition(opcode)) {
+                PC = ReadWord(PC);
             } else {
                 PC += 2;
             }
             break;
         case 0xD3: // OUT D8
             {
-                std::cout << "OUT " << std::hex << (int)memory[PC] << std::endl;
-                uint8_t port = memory[PC];
+                if (verbose) std::cout << "OUT " << std::hex << (int)memory.Read(PC) << " " << (int)A << std::dec << std::endl;
+                ioCount++;
+                uint8_t port = memory.Read(PC);
                 PC++;
                 OutPort(port, A);
                 break;
             }
         case 0xD4: // CNC adr
-            if (!(flags & 0x10)) {
-                memory[SP - 1] = (PC >> 8) & 0xFF;
-                memory[SP - 2] = PC & 0xFF;
-                SP -= 2;
-                PC = memory[PC] | (memory[PC + 1] << 8);
+            if (Condition(opcode)) {
+                Push(PC + 2);
+                PC = ReadWord(PC);
+                cycles += OPCODES[opcode].takenCycles; // Taken
             } else {
                 PC += 2;
             }
             break;
         case 0xD5: // PUSH D
-            memory[SP - 1] = D;
-            memory[SP - 2] = E;
+            memory.Write(SP - 1, D);
+            memory.Write(SP - 2, E);
             SP -= 2;
             break;
         case 0xD6: // SUI D8
-            {
-                uint16_t result = A - memory[PC];
-                A = result & 0xFF;
-                flags = (result > 0xFF) ? 1 : 0;
-                PC++;
-            }
+            Subtract(memory.Read(PC), 0);
+            PC++;
             break;
         case 0xD7: // RST 2
-            memory[SP - 1] = (PC >> 8) & 0xFF;
-            memory[SP - 2] = PC & 0xFF;
+            memory.Write(SP - 1, (PC >> 8) & 0xFF);
+            memory.Write(SP - 2, PC & 0xFF);
             SP -= 2;
             PC = 0x10;
             break;
         case 0xD8: // RC
-            if (flags & 0x10) {
-                PC = memory[SP] | (memory[SP + 1] << 8);
-                SP += 2;
+            if (Condition(opcode)) {
+                PC = Pop();
+                cycles += OPCODES[opcode].takenCycles; // Taken
             }
             break;
-        case 0xD9: // -
+        case 0xD9: // RET (undocumented)
+            PC = Pop();
             break;
         case 0xDA: // JC adr
-            if (flags & 0x10) {
-                PC = memory[PC] | (memory[PC + 1] << 8);
+            if (Condition(opcode)) {
+                PC = ReadWord(PC);
             } else {
                 PC += 2;
             }
             break;
         case 0xDB: // IN D8
         {
-            std::cout << "IN " << std::hex << (int)memory[PC] << std::endl;
-            uint8_t port = memory[PC];
+            if (verbose) std::cout << "IN " << std::hex << (int)memory.Read(PC) << std::endl;
+            ioCount++;
+            uint8_t port = memory.Read(PC);
             PC++;
             A = InPort(port);
             break;
         }
         case 0xDC: // CC adr
-            if (flags & 0x10) {
-                memory[SP - 1] = (PC >> 8) & 0xFF;
-                memory[SP - 2] = PC & 0xFF;
-                SP -= 2;
-                PC = memory[PC] | (memory[PC + 1] << 8);
+            if (Condition(opcode)) {
+                Push(PC + 2);
+                PC = ReadWord(PC);
+                cycles += OPCODES[opcode].takenCycles; // Taken
             } else {
                 PC += 2;
             }
             break;
-        case 0xDD: // -
+        case 0xDD: // CALL adr (undocumented)
+            Push(PC + 2);
+            PC = ReadWord(PC);
             break;
         case 0xDE: // SBI D8
-            {
-                uint16_t result = A - memory[PC] - flags;
-                A = result & 0xFF;
-                flags = (result > 0xFF) ? 1 : 0;
-                PC++;
-            }
+            Subtract(memory.Read(PC), flags & FLAG_CARRY);
+            PC++;
             break;
         case 0xDF: // RST 3
-            memory[SP - 1] = (PC >> 8) & 0xFF;
-            memory[SP - 2] = PC & 0xFF;
+            memory.Write(SP - 1, (PC >> 8) & 0xFF);
+            memory.Write(SP - 2, PC & 0xFF);
             SP -= 2;
             PC = 0x18;
             break;
         case 0xE0: // RPO
-            if (!(flags & 0x04)) {
-                PC = memory[SP] | (memory[SP + 1] << 8);
-                SP += 2;
+            if (Condition(opcode)) {
+                PC = Pop();
+                cycles += OPCODES[opcode].takenCycles; // Taken
             }
             break;
         case 0xE1: // POP H
-            L = memory[SP];
-            H = memory[SP + 1];
+            L = memory.Read(SP);
+            H = memory.Read(SP + 1);
             SP += 2;
             break;
         case 0xE2: // JPO adr
-            if (!(flags & 0x04)) {
-                PC = memory[PC] | (memory[PC + 1] << 8);
+            if (Condition(opcode)) {
+                PC = ReadWord(PC);
             } else {
                 PC += 2;
             }
@@ -1268,174 +1291,170 @@ void CPU8080::EmulateCycle() {
         case 0xE3: // XTHL
             {
                 uint8_t temp = L;
-                L = memory[SP];
-                memory[SP] = temp;
+                L = memory.Read(SP);
+                memory.Write(SP, temp);
                 temp = H;
-                H = memory[SP + 1];
-                memory[SP + 1] = temp;
+                H = memory.Read(SP + 1);
+                memory.Write(SP + 1, temp);
             }
             break;
         case 0xE4: // CPO adr
-            if (!(flags & 0x04)) {
-                memory[SP - 1] = (PC >> 8) & 0xFF;
-                memory[SP - 2] = PC & 0xFF;
-                SP -= 2;
-                PC = memory[PC] | (memory[PC + 1] << 8);
+            if (Condition(opcode)) {
+                Push(PC + 2);
+                PC = ReadWord(PC);
+                cycles += OPCODES[opcode].takenCycles; // Taken
             } else {
                 PC += 2;
             }
             break;
         case 0xE5: // PUSH H
-            memory[SP - 1] = H;
-            memory[SP - 2] = L;
+            memory.Write(SP - 1, H);
+            memory.Write(SP - 2, L);
             SP -= 2;
             break;
         case 0xE6: // ANI D8
-            A &= memory[PC];
-            flags = (A == 0) ? 1 : 0;
+            And(memory.Read(PC));
             PC++;
             break;
         case 0xE7: // RST 4
-            memory[SP - 1] = (PC >> 8) & 0xFF;
-            memory[SP - 2] = PC & 0xFF;
+            memory.Write(SP - 1, (PC >> 8) & 0xFF);
+            memory.Write(SP - 2, PC & 0xFF);
             SP -= 2;
             PC = 0x20;
             break;
         case 0xE8: // RPE
-            if (flags & 0x04) {
-                PC = memory[SP] | (memory[SP + 1] << 8);
-                SP += 2;
+            if (Condition(opcode)) {
+                PC = Pop();
+                cycles += OPCODES[opcode].takenCycles; // Taken
             }
             break;
         case 0xE9: // PCHL
             PC = (H << 8) | L;
             break;
         case 0xEA: // JPE adr
-            if (flags & 0x04) {
-                PC = memory[PC] | (memory[PC + 1] << 8);
+            if (Condition(opcode)) {
+                PC = ReadWord(PC);
             } else {
                 PC += 2;
             }
             break;
         case 0xEB: // XCHG
             {
-                uint8_t temp = L;
-                L = D;
+                uint8_t temp = H;
+                H = D;
                 D = temp;
-                temp = H;
-                H = E;
+                temp = L;
+                L = E;
                 E = temp;
             }
             break;
         case 0xEC: // CPE adr
-            if (flags & 0x04) {
-                memory[SP - 1] = (PC >> 8) & 0xFF;
-                memory[SP - 2] = PC & 0xFF;
-                SP -= 2;
-                PC = memory[PC] | (memory[PC + 1] << 8);
+            if (Condition(opcode)) {
+                Push(PC + 2);
+                PC = ReadWord(PC);
+                cycles += OPCODES[opcode].takenCycles; // Taken
             } else {
                 PC += 2;
             }
             break;
-        case 0xED: // -
+        case 0xED: // CALL adr (undocumented)
+            Push(PC + 2);
+            PC = ReadWord(PC);
             break;
         case 0xEE: // XRI D8
-            A ^= memory[PC];
-            flags = (A == 0) ? 1 : 0;
+            Xor(memory.Read(PC));
             PC++;
             break;
         case 0xEF: // RST 5
-            memory[SP - 1] = (PC >> 8) & 0xFF;
-            memory[SP - 2] = PC & 0xFF;
+            memory.Write(SP - 1, (PC >> 8) & 0xFF);
+            memory.Write(SP - 2, PC & 0xFF);
             SP -= 2;
             PC = 0x28;
             break;
         case 0xF0: // RP
-            if (!(flags & 0x08)) {
-                PC = memory[SP] | (memory[SP + 1] << 8);
-                SP += 2;
+            if (Condition(opcode)) {
+                PC = Pop();
+                cycles += OPCODES[opcode].takenCycles; // Taken
             }
             break;
         case 0xF1: // POP PSW
-            A = memory[SP + 1];
-            flags = memory[SP];
-            SP += 2;
+            {
+                uint16_t psw = Pop();
+                A = psw >> 8;
+                flags = (psw & FLAG_MASK) | FLAG_ALWAYS_ON;
+            }
             break;
         case 0xF2: // JP adr
-            if (!(flags & 0x08)) {
-                PC = memory[PC] | (memory[PC + 1] << 8);
+            if (Condition(opcode)) {
+                PC = ReadWord(PC);
             } else {
                 PC += 2;
             }
             break;
         case 0xF3: // DI
+            interruptsEnabled = false;
             break;
         case 0xF4: // CP adr
-            if (!(flags & 0x08)) {
-                memory[SP - 1] = (PC >> 8) & 0xFF;
-                memory[SP - 2] = PC & 0xFF;
-                SP -= 2;
-                PC = memory[PC] | (memory[PC + 1] << 8);
+            if (Condition(opcode)) {
+                Push(PC + 2);
+                PC = ReadWord(PC);
+                cycles += OPCODES[opcode].takenCycles; // Taken
             } else {
                 PC += 2;
             }
             break;
         case 0xF5: // PUSH PSW
-            memory[SP - 1] = A;
-            memory[SP - 2] = flags;
-            SP -= 2;
+            Push((A << 8) | flags);
             break;
         case 0xF6: // ORI D8
-            A |= memory[PC];
-            flags = (A == 0) ? 1 : 0;
+            Or(memory.Read(PC));
             PC++;
             break;
         case 0xF7: // RST 6
-            memory[SP - 1] = (PC >> 8) & 0xFF;
-            memory[SP - 2] = PC & 0xFF;
+            memory.Write(SP - 1, (PC >> 8) & 0xFF);
+            memory.Write(SP - 2, PC & 0xFF);
             SP -= 2;
             PC = 0x30;
             break;
         case 0xF8: // RM
-            if (flags & 0x08) {
-                PC = memory[SP] | (memory[SP + 1] << 8);
-                SP += 2;
+            if (Condition(opcode)) {
+                PC = Pop();
+                cycles += OPCODES[opcode].takenCycles; // Taken
             }
             break;
         case 0xF9: // SPHL
             SP = (H << 8) | L;
             break;
         case 0xFA: // JM adr
-            if (flags & 0x08) {
-                PC = memory[PC] | (memory[PC + 1] << 8);
+            if (Condition(opcode)) {
+                PC = ReadWord(PC);
             } else {
                 PC += 2;
             }
             break;
         case 0xFB: // EI
+            interruptsEnabled = true;
             break;
         case 0xFC: // CM adr
-            if (flags & 0x08) {
-                memory[SP - 1] = (PC >> 8) & 0xFF;
-                memory[SP - 2] = PC & 0xFF;
-                SP -= 2;
-                PC = memory[PC] | (memory[PC + 1] << 8);
+            if (Condition(opcode)) {
+                Push(PC + 2);
+                PC = ReadWord(PC);
+                cycles += OPCODES[opcode].takenCycles; // Taken
             } else {
                 PC += 2;
             }
             break;
-        case 0xFD: // -
+        case 0xFD: // CALL adr (undocumented)
+            Push(PC + 2);
+            PC = ReadWord(PC);
             break;
         case 0xFE: // CPI D8
-            {
-                uint16_t result = A - memory[PC];
-                flags = (result > 0xFF) ? 1 : 0;
-                PC++;
-            }
+            Compare(memory.Read(PC));
+            PC++;
             break;
         case 0xFF: // RST 7
-            memory[SP - 1] = (PC >> 8) & 0xFF;
-            memory[SP - 2] = PC & 0xFF;
+            memory.Write(SP - 1, (PC >> 8) & 0xFF);
+            memory.Write(SP - 2, PC & 0xFF);
             SP -= 2;
             PC = 0x38;
             break;
@@ -1443,4 +1462,54 @@ void CPU8080::EmulateCycle() {
             std::cerr << "Error: Unimplemented opcode " << std::hex << (int)opcode << std::endl;
             break;
     }
+
+    PROFILE_INSTRUCTION_END(instructionPC, opcode);
+
+    // Short backward branch: candidate polling loop
+    if (idleSkipping && PC < instructionPC && instructionPC - PC <= IDLE_LOOP_MAX_BYTES) {
+        CheckIdleLoop();
+    }
+}
+
+// The opcodes are constants here, so each inlined Execute reduces to the code of one instruction
+template <uint8_t... OPCODES>
+ALWAYS_INLINE void CPU8080::RunFused() {
+    (Execute(OPCODES), ...);
+}
+
+// Compared against constant indexes in list order, so that every handler is inlined into EmulateCycle
+ALWAYS_INLINE void CPU8080::RunSuperinstruction(int index) {
+    int next = 0;
+#define SUPERINSTRUCTION_CASE(name, ...) if (index == next++) { RunFused<__VA_ARGS__>(); return; }
+    SUPERINSTRUCTION_LIST(SUPERINSTRUCTION_CASE)
+#undef SUPERINSTRUCTION_CASE
+}
+
+// Record the instructions of a superinstruction one by one, as if they had been interpreted
+void CPU8080::RecordFused(const Superinstruction& sequence) {
+    uint16_t pc = PC;
+    for (int i = 0; i < sequence.length; ++i) {
+        sequenceProfile->Record(pc, sequence.opcodes[i]);
+        pc += OPCODES[sequence.opcodes[i]].length;
+    }
+}
+
+void CPU8080::EmulateCycle() {
+    if (trace) Trace();
+
+    // Fused sequence starting here in the pre-decoded ROM
+    if (superinstructions && PC < ROM_SIZE) {
+        uint8_t fused = superinstructions[PC];
+        // With interrupts enabled a sequence must end by the next interrupt, or the interrupt
+        // would be taken later than between single instructions
+        if (fused && (!interruptsEnabled || cycles + FUSED_CYCLES[fused - 1] <= cycleLimit)) {
+            if (sequenceProfile) RecordFused(SUPERINSTRUCTIONS[fused - 1]);
+            RunSuperinstruction(fused - 1);
+            return;
+        }
+    }
+
+    uint8_t opcode = memory.Read(PC); // Fetch opcode from memory
+    if (sequenceProfile) sequenceProfile->Record(PC, opcode);
+    Execute(opcode);
 }
@@ -2,34 +2,153 @@
 #define CPU_H
 
 #include <cstdint>
-#include "graphics.h"
+#include <memory>
+#include <ostream>
+#include <vector>
+#include "devices.h"
+#include "io_bus.h"
+#include "memory.h"
+#include "profiler.h"
+#include "superinstructions.h"
+
+// Full machine state used for fast save/restore
+struct CPUSnapshot {
+    uint8_t A, B, C, D, E, H, L; // General purpose registers and accumulator
+    uint16_t SP, PC; // Stack pointer and program counter
+    uint8_t flags; // Flags register
+    uint8_t port1, port2; // Input ports
+    ShiftRegister shifter; // I/O devices
+    SoundLatches sound;
+    Watchdog watchdog;
+    bool interruptsEnabled; // Interrupt enable flip-flop
+    bool halted; // Stopped by HLT until the next interrupt
+    uint64_t cycles, frames; // Emulated time
+    uint64_t frameOffset; // Cycles of the current frame already run by RunFrameUntil
+    uint64_t instructions;
+    Memory memory; // 64KB of memory, shared copy-on-write with the machine
+};
 
 class CPU8080 {
 public:
     uint8_t A, B, C, D, E, H, L; // General purpose registers and accumulator
     uint16_t SP, PC; // Stack pointer and program counter
-    uint8_t flags; // Flags register
+    uint8_t flags; // Flags register, laid out as the low byte of PSW
 
-    uint8_t memory[0x10000]; // 64KB of memory
+    // Flag bits
+    static const uint8_t FLAG_CARRY = 0x01;
+    static const uint8_t FLAG_ALWAYS_ON = 0x02; // Bit 1 of PSW always reads as 1
+    static const uint8_t FLAG_PARITY = 0x04;
+    static const uint8_t FLAG_AUX_CARRY = 0x10;
+    static const uint8_t FLAG_ZERO = 0x40;
+    static const uint8_t FLAG_SIGN = 0x80;
+    static const uint8_t FLAG_MASK = 0xD5; // Bits that instructions can change
 
-    uint8_t InPort(uint8_t port); // Read from an input port
+    Memory memory; // 64KB of memory
 
     uint8_t port1; // Buttons state for player 1
     uint8_t port2; // Buttons state for player 2 and others
 
-    void OutPort(uint8_t port, uint8_t value); // Write to an output port
+    // I/O devices of the Space Invaders board, wired to their ports by SpaceInvadersBus()
+    ShiftRegister shifter;
+    SoundLatches sound;
+    Watchdog watchdog;
+
+    const IoBus<CPU8080>* io; // Port map used by IN and OUT, SpaceInvadersBus() unless replaced
+    static const IoBus<CPU8080>& SpaceInvadersBus();
+
+    uint8_t InPort(uint8_t port) { return io->Read(*this, port); } // Read from an input port
+    void OutPort(uint8_t port, uint8_t value) { io->Write(*this, port, value); } // Write to an output port
+
+    static const int ROM_SIZE = 0x2000; // invaders.h/g/f/e, read-only
+    static const int CLOCK_RATE = 2000000; // 2 MHz Intel 8080
+    static const int CYCLES_PER_FRAME = CLOCK_RATE / 60; // Cycles between two VBlank interrupts
+    static const int MID_SCREEN_CYCLE = CYCLES_PER_FRAME / 2; // Cycles into the frame of the mid-screen interrupt
+
+    uint64_t cycles; // Cycles executed since reset
+    uint64_t frames; // Frames executed since reset
+    uint64_t frameOffset; // Cycles into the current frame reached by RunFrameUntil, 0 between frames
+    uint64_t instructions; // Instructions interpreted since reset (HLE hooks and idle skips excluded)
+    bool interruptsEnabled; // Interrupt enable flip-flop (EI/DI)
+    bool halted; // Stopped by HLT until the next interrupt
+    bool verbose; // Print IN/OUT debugging output
+
+    bool idleSkipping; // Fast-forward idle polling loops to the next interrupt (disable for accuracy comparisons)
+    uint64_t skippedCycles; // Cycles credited without emulation while halted or idle
+
+    // Next interrupt, set by Step: superinstructions and HLE hooks that would run past it
+    // while interrupts are enabled fall back to single instructions
+    uint64_t cycleLimit;
+    static const uint64_t NO_CYCLE_LIMIT = ~0ull;
+
+    uint32_t hleHooks; // Mask of enabled high-level emulation hooks (see hle.h), 0 when off
+
+    SequenceProfile* sequenceProfile; // When set, every executed instruction is recorded, fused ones included (not owned)
+    SoundEventQueue* soundEvents; // When set, sound latch changes are pushed here (not owned)
+    std::ostream* trace; // When set, every dispatch is disassembled here with the registers before it (not owned)
+#ifdef I8080_PROFILER
+    Profiler* profiler; // When set, every instruction, interrupt and idle skip is profiled (not owned)
+#endif
 
     CPU8080();
     void Reset(); // Reset the CPU to its initial state
     void LoadProgram(const char* rom1, const char* rom2, const char* rom3, const char* rom4); // Load a program into memory
+    size_t LoadFile(const char* path, uint16_t address, size_t maxSize = 0x10000); // Load a binary at address, returns its size
+    void LoadRom(const uint8_t* data, size_t size); // Load a ROM image at 0x0000 and write-protect the ROM area
     void EmulateCycle(); // Emulate a single cycle
+    void Step(uint64_t limit); // One instruction, superinstruction or HLE hook, or an idle skip up to limit
+    void RunFrame(); // Emulate a full video frame, including the mid-screen and VBlank interrupts
+    void RunFrameUntil(uint64_t offset); // Emulate the current frame up to offset cycles into it, completing it at CYCLES_PER_FRAME
+    void GenerateInterrupt(int number); // Execute RST number if interrupts are enabled
     void PrintState(); // Print the state of the CPU
 
-    void RenderGraphics(Graphics& graphics); // Render the graphics
+    void SaveState(CPUSnapshot& snapshot) const; // Copy the machine state into a snapshot
+    void LoadState(const CPUSnapshot& snapshot); // Restore the machine state from a snapshot
+    CPU8080 Fork() const; // Child machine sharing this one's memory pages copy-on-write
+
+    int EnableHle(bool report); // Validate the ROM routine hooks and enable those that pass, returns how many
+    void EnableSuperinstructions(bool enable); // Pre-decode the ROM and dispatch fused instruction sequences
 
 private:
-    uint8_t shiftRegister; // Register shift for graphics
-    uint8_t shiftOffset; // Offset for shift registers graphics
+    static const int IDLE_LOOP_MAX_BYTES = 16; // Longest backward branch considered a polling loop
+
+    void Execute(uint8_t opcode); // Execute one already fetched opcode
+    void Trace(); // Write the trace line of the instruction at PC
+
+    // Instruction building blocks
+    uint16_t ReadWord(uint16_t address) const; // Little-endian 16-bit operand
+    void Push(uint16_t value);
+    uint16_t Pop();
+    bool Condition(uint8_t opcode) const; // Condition encoded in bits 3-5 (NZ, Z, NC, C, PO, PE, P, M)
+    void Add(uint8_t value, uint8_t carry); // ADD/ADC: A += value + carry
+    void Subtract(uint8_t value, uint8_t borrow); // SUB/SBB: A -= value + borrow
+    void Compare(uint8_t value); // CMP: flags of A - value
+    void And(uint8_t value);
+    void Xor(uint8_t value);
+    void Or(uint8_t value);
+    uint8_t Increment(uint8_t value); // INR: all flags but carry
+    uint8_t Decrement(uint8_t value); // DCR: all flags but carry
+    void DoubleAdd(uint16_t value); // DAD: HL += value, carry only
+    void DecimalAdjust(); // DAA
+    template <uint8_t... OPCODES> void RunFused(); // Superinstruction handler
+    void RecordFused(const Superinstruction& sequence); // Feed a superinstruction about to run to sequenceProfile
+    void RunSuperinstruction(int index); // Run SUPERINSTRUCTIONS[index]
+
+    std::shared_ptr<const std::vector<uint8_t>> superinstructionTable; // Pre-decoded ROM, shared by forks
+    const uint8_t* superinstructions; // superinstructionTable data, nullptr when disabled
+
+    void RunUntil(uint64_t targetCycle); // Emulate instructions until the cycle counter reaches targetCycle
+    void CheckIdleLoop(); // Called on short backward branches to detect a loop that cannot make progress
+    void ResetIdleDetector();
+
+    // Idle loop detector: state seen the last time a short backward branch was taken
+    bool idle; // The loop repeats identically until the next interrupt
+    uint16_t idleLoopPC;
+    uint64_t idleCycles; // Cycle counter when idleLoopPC was last reached
+    uint64_t idleLoopCycles; // Cycles of one iteration of the idle loop
+    uint8_t idleRegisters[8];
+    uint16_t idleSP;
+    uint32_t idleWrites, idleIO;
+    uint32_t ioCount; // IN/OUT instructions executed, wraps around
 };
 
 #endif
\ No newline at end of file
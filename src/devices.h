@@ -0,0 +1,83 @@
+#ifndef DEVICES_H
+#define DEVICES_H
+
+#include <cstdint>
+#include "io_bus.h"
+#include "spsc_queue.h"
+
+// Space Invaders I/O devices. Each one maps its handlers onto an IoBus with Attach,
+// given the member of the machine that holds it and the ports it is wired to.
+
+// Shift hardware used to draw sprites at any horizontal pixel: a 16-bit register that
+// each data write shifts right by 8, entering the byte at the top, and a 3-bit offset
+// selecting which 8 bits of it the result port returns
+struct ShiftRegister {
+    uint16_t value; // Last two bytes written, the newest in the high byte
+    uint8_t offset; // Bits 0-2 of the last offset write
+
+    void WriteOffset(uint8_t data) { offset = data & 0x07; }
+    void WriteData(uint8_t data) { value = (value >> 8) | (data << 8); }
+    uint8_t Read() { return (value >> (8 - offset)) & 0xFF; }
+
+    // Batched data write / result read pairs, as the ROM's sprite routines issue them one
+    // OUT and IN at a time: shifts in each byte of data and stores the result after it
+    void Shift(const uint8_t* data, uint8_t* results, int count) {
+        for (int i = 0; i < count; ++i) {
+            value = (value >> 8) | (data[i] << 8);
+            results[i] = (value >> (8 - offset)) & 0xFF;
+        }
+    }
+
+    template <auto DEVICE, class Machine>
+    static void Attach(IoBus<Machine>& bus, uint8_t offsetPort, uint8_t dataPort, uint8_t resultPort) {
+        bus.template MapOutput<DEVICE, &ShiftRegister::WriteOffset>(offsetPort);
+        bus.template MapOutput<DEVICE, &ShiftRegister::WriteData>(dataPort);
+        bus.template MapInput<DEVICE, &ShiftRegister::Read>(resultPort);
+    }
+};
+
+// Change of a sound latch bank, stamped with the emulated cycle of the OUT that made it
+struct SoundEvent {
+    uint64_t cycle;
+    uint8_t bank; // 1 (port 3) or 2 (port 5)
+    uint8_t latches; // New value of the bank
+    uint8_t changed; // Bits that differ from the previous value
+};
+
+typedef SpscQueue<SoundEvent, 1024> SoundEventQueue;
+
+// Sound trigger latches: each bit of the two banks starts or stops one sound. Writes that
+// change a bit are pushed to the machine's soundEvents queue when it has one; the
+// emulation never waits for the consumer, a full queue drops the event.
+struct SoundLatches {
+    uint8_t bank1; // Port 3: UFO (looping), shot, player death, invader death, extended play, amplifier
+    uint8_t bank2; // Port 5: fleet movement 1-4, UFO hit
+
+    template <auto DEVICE, int BANK, class Machine>
+    static void Write(Machine& machine, uint8_t data) {
+        uint8_t& latches = BANK == 1 ? (machine.*DEVICE).bank1 : (machine.*DEVICE).bank2;
+        uint8_t changed = latches ^ data;
+        latches = data;
+        if (changed && machine.soundEvents) machine.soundEvents->Push({ machine.cycles, BANK, data, changed });
+    }
+
+    template <auto DEVICE, class Machine>
+    static void Attach(IoBus<Machine>& bus, uint8_t bank1Port, uint8_t bank2Port) {
+        bus.MapOutput(bank1Port, &Write<DEVICE, 1, Machine>);
+        bus.MapOutput(bank2Port, &Write<DEVICE, 2, Machine>);
+    }
+};
+
+// Watchdog the game kicks regularly; the emulator never lets it expire and only counts the kicks
+struct Watchdog {
+    uint32_t kicks;
+
+    void Write(uint8_t) { kicks++; }
+
+    template <auto DEVICE, class Machine>
+    static void Attach(IoBus<Machine>& bus, uint8_t port) {
+        bus.template MapOutput<DEVICE, &Watchdog::Write>(port);
+    }
+};
+
+#endif
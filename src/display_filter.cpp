@@ -0,0 +1,84 @@
+#include "display_filter.h"
+#include <cstring>
+
+static const uint32_t WHITE = 0xFFFFFF;
+static const uint32_t RED = 0xFF2020;
+static const uint32_t GREEN = 0x20FF20;
+
+// Overlay bands in upright screen rows and columns
+static const int RED_TOP = 32; // Flying saucer
+static const int RED_BOTTOM = 64;
+static const int GREEN_TOP = 184; // Shields and player
+static const int LIVES_TOP = 240; // Below here only the reserve cannons are green, not the credit count
+static const int LIVES_LEFT = 16;
+static const int LIVES_RIGHT = 134;
+
+DisplayFilter::DisplayFilter() : overlay(false), scanlines(false), scale(1) {
+    for (int x = 0; x < WIDTH; ++x) {
+        lineBands[x] = x >= LIVES_LEFT && x < LIVES_RIGHT ? LIVES_COLUMNS : OTHER_COLUMNS;
+    }
+    Build();
+}
+
+void DisplayFilter::SetOverlay(bool enabled) {
+    overlay = enabled;
+    Build();
+}
+
+void DisplayFilter::SetScanlines(bool enabled) {
+    scanlines = enabled;
+    Build();
+}
+
+void DisplayFilter::SetScale(int factor) {
+    scale = factor < 1 ? 1 : factor > MAX_SCALE ? MAX_SCALE : factor;
+    Build();
+}
+
+void DisplayFilter::Build() {
+    for (int band = 0; band < BANDS; ++band) {
+        for (int column = 0; column < scale; ++column) {
+            for (int y = 0; y < HEIGHT; ++y) {
+                uint32_t color = WHITE;
+                if (overlay && y >= RED_TOP && y < RED_BOTTOM) color = RED;
+                if (overlay && y >= GREEN_TOP && (y < LIVES_TOP || band == LIVES_COLUMNS)) color = GREEN;
+                // The monitor is on its side, so raster lines are screen columns: the last
+                // output column of each is the dark gap before the next
+                if (scanlines && scale > 1 && column == scale - 1) color = (color >> 1) & 0x7F7F7F;
+                colors[band][column][y] = color;
+            }
+        }
+    }
+}
+
+void DisplayFilter::Convert(const uint8_t* vram, int first, int count, void* pixels, int pitch) const {
+    switch (scale) {
+        case 1: ConvertScaled<1>(vram, first, count, pixels, pitch); break;
+        case 2: ConvertScaled<2>(vram, first, count, pixels, pitch); break;
+        case 3: ConvertScaled<3>(vram, first, count, pixels, pitch); break;
+        default: ConvertScaled<4>(vram, first, count, pixels, pitch); break;
+    }
+}
+
+template <int SCALE>
+void DisplayFilter::ConvertScaled(const uint8_t* vram, int first, int count, void* pixels, int pitch) const {
+    // VRAM is rotated: each 32-byte raster line is one screen column, bit 0 of its first
+    // byte at the bottom. Output goes a row at a time, reading VRAM (small enough to stay
+    // in cache) across the lines, so the larger scaled output is written in order.
+    for (int y = 0; y < HEIGHT; ++y) {
+        int byte = (HEIGHT - 1 - y) / 8;
+        int bit = (HEIGHT - 1 - y) % 8;
+        uint32_t* row = reinterpret_cast<uint32_t*>(static_cast<uint8_t*>(pixels) + y * SCALE * pitch);
+        for (int x = 0; x < count; ++x) {
+            int line = first + x;
+            uint32_t lit = 0u - ((vram[line * 32 + byte] >> bit) & 1); // All ones or zero
+            const uint32_t(&bandColors)[MAX_SCALE][HEIGHT] = colors[lineBands[line]];
+            for (int column = 0; column < SCALE; ++column) {
+                row[x * SCALE + column] = bandColors[column][y] & lit;
+            }
+        }
+        for (int copy = 1; copy < SCALE; ++copy) {
+            std::memcpy(reinterpret_cast<uint8_t*>(row) + copy * pitch, row, count * SCALE * sizeof(uint32_t));
+        }
+    }
+}
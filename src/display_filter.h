@@ -0,0 +1,47 @@
+#ifndef DISPLAY_FILTER_H
+#define DISPLAY_FILTER_H
+
+#include <cstdint>
+
+// Converts packed 1bpp VRAM into RGB888 pixels with the cabinet's colour overlay,
+// integer scaling and scanlines. The settings are baked into per-row colour tables
+// whenever they change, so the conversion loop is the same for every combination:
+// each pixel is its row's colour masked by its VRAM bit, with no branch on the
+// settings or on the pixel.
+class DisplayFilter {
+public:
+    static const int WIDTH = 224; // Upright screen, before scaling
+    static const int HEIGHT = 256;
+    static const int MAX_SCALE = 4;
+
+    DisplayFilter();
+
+    void SetOverlay(bool enabled); // Red band at the top, green at the bottom, as the cabinet's gel strips
+    void SetScanlines(bool enabled); // Darken the gap between raster lines, from scale 2 up
+    void SetScale(int factor); // 1 to MAX_SCALE output pixels per screen pixel
+    bool Overlay() const { return overlay; }
+    bool Scanlines() const { return scanlines; }
+    int Scale() const { return scale; }
+    int Width() const { return WIDTH * scale; }
+    int Height() const { return HEIGHT * scale; }
+
+    // Raster lines first to first + count - 1 of VRAM (screen columns, each scale pixels
+    // wide) into pixels, which point at the output column of line first
+    void Convert(const uint8_t* vram, int first, int count, void* pixels, int pitch) const;
+
+private:
+    // The overlay's bottom band only covers the lives counter's columns in the last rows
+    enum Band { OTHER_COLUMNS, LIVES_COLUMNS, BANDS };
+
+    void Build();
+    template <int SCALE>
+    void ConvertScaled(const uint8_t* vram, int first, int count, void* pixels, int pitch) const;
+
+    bool overlay;
+    bool scanlines;
+    int scale;
+    uint8_t lineBands[WIDTH]; // Band of each raster line
+    uint32_t colors[BANDS][MAX_SCALE][HEIGHT]; // Lit colour per band, output column within a line, and screen row
+};
+
+#endif
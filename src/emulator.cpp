@@ -0,0 +1,224 @@
+#include "emulator.h"
+#include <algorithm>
+#include <iostream>
+
+Emulator::Emulator(CPU8080& cpu)
+    : cpu(cpu), running(false), turbo(false), speed(1.0), runAhead(0), runAheadCost(0), rateAdjustment(0), inputEvents(0),
+      inputLatencyTotal(0), inputLatencyMax(0), displayRate(60), perf(nullptr), audio(nullptr),
+      audioSync(false), capture(nullptr), screenExport(nullptr), frameLimit(0), publishInterval(1), unpublishedFrames(0), speedFrames(0), runAheadTime(0), runAheadFrames(0), smoothedLatency(0),
+      latencyErrorSum(0), scanOut() {
+}
+
+Emulator::~Emulator() {
+    Stop();
+}
+
+void Emulator::SetFrameRate(uint32_t numerator, uint32_t denominator) {
+    pacer.SetRate(numerator, denominator);
+}
+
+void Emulator::Start() {
+    if (running) return;
+    running = true;
+    thread = std::thread(&Emulator::Run, this);
+}
+
+void Emulator::Stop() {
+    running = false;
+    if (thread.joinable()) {
+        thread.join();
+    }
+}
+
+bool Emulator::PushInput(const InputEvent& event) {
+    return input.Push(event);
+}
+
+const VideoFrame* Emulator::LatestFrame() {
+    return frames.Latest();
+}
+
+FrameStats Emulator::Statistics() {
+    const FrameStats* latest = stats.Latest();
+    return latest ? *latest : stats.Front();
+}
+
+void Emulator::ApplyInput() {
+    InputEvent event;
+    while (input.Pop(event)) {
+        double latency = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - event.received).count();
+        inputLatencyTotal = inputLatencyTotal + latency;
+        inputLatencyMax = std::max((double)inputLatencyMax, latency);
+        inputEvents++;
+
+        uint8_t& port = event.port == 2 ? cpu.port2 : cpu.port1;
+        if (event.pressed) {
+            port |= event.mask;
+        } else {
+            port &= ~event.mask;
+        }
+    }
+}
+
+void Emulator::ScanOut(int first, int last) {
+    int start = first * VideoFrame::LINE_BYTES;
+    cpu.memory.CopyOut(VideoFrame::VRAM_START + start, scanOut + start, (last - first) * VideoFrame::LINE_BYTES);
+}
+
+void Emulator::PublishFrame(int lines) {
+    if (lines == VideoFrame::LINES) ScanOut(VideoFrame::MID_SCREEN_LINE, VideoFrame::LINES);
+    VideoFrame& frame = frames.Back();
+    frame.number = lines == VideoFrame::LINES ? cpu.frames : cpu.frames + 1; // cpu.frames counts finished frames
+    frame.lines = lines;
+    std::copy(scanOut, scanOut + lines * VideoFrame::LINE_BYTES, frame.vram);
+    frames.Publish();
+}
+
+void Emulator::PublishRunAhead(int count) {
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+    // The snapshot shares memory pages with the machine, so saving and restoring
+    // cost a few pointer copies plus the pages the frames ahead write to
+    cpu.SaveState(runAheadState);
+    bool verbose = cpu.verbose;
+    cpu.verbose = false;
+    std::ostream* trace = cpu.trace; // Likewise for the trace
+    cpu.trace = nullptr;
+    SoundEventQueue* soundEvents = cpu.soundEvents; // The frames ahead are heard when they are run for real
+    cpu.soundEvents = nullptr;
+#ifdef I8080_PROFILER
+    Profiler* profiler = cpu.profiler; // Frames that are thrown away are not part of the profile
+    cpu.profiler = nullptr;
+#endif
+    for (int i = 0; i < count; ++i) {
+        RunFrame();
+    }
+    PublishFrame();
+    cpu.verbose = verbose;
+    cpu.trace = trace;
+    cpu.soundEvents = soundEvents;
+#ifdef I8080_PROFILER
+    cpu.profiler = profiler;
+#endif
+    cpu.LoadState(runAheadState);
+
+    runAheadTime += std::chrono::steady_clock::now() - start;
+    runAheadFrames++;
+}
+
+void Emulator::MeasureSpeed(bool turboFrame) {
+    std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+    double elapsed = std::chrono::duration<double>(now - speedStart).count();
+    if (elapsed * 1000 < SPEED_INTERVAL_MS) return;
+
+    double framesPerSecond = (cpu.frames - speedFrames) / elapsed;
+    speed = framesPerSecond / pacer.Rate();
+    speedStart = now;
+    speedFrames = cpu.frames;
+
+    runAheadCost = runAheadFrames ? std::chrono::duration<double, std::milli>(runAheadTime).count() / runAheadFrames : 0;
+    runAheadTime = std::chrono::steady_clock::duration(0);
+    runAheadFrames = 0;
+
+    // Show as many frames as the display can, skip the rest
+    publishInterval = turboFrame ? std::max(1, (int)(framesPerSecond / displayRate + 0.5)) : 1;
+}
+
+void Emulator::FollowAudioClock() {
+    // Too much emulated time queued ahead of the output: run slower, too little: faster
+    smoothedLatency += (audio->Latency() - smoothedLatency) * LATENCY_SMOOTHING;
+    // Proportional term for the error now, integral term for the steady drift between the clocks
+    double error = (smoothedLatency - audio->TargetLatency()) / 1000.0;
+    double limit = MAX_RATE_ADJUSTMENT / DRIFT_GAIN;
+    latencyErrorSum = std::max(-limit, std::min(limit, latencyErrorSum + error / pacer.Rate()));
+    double adjustment = -error * RATE_GAIN - latencyErrorSum * DRIFT_GAIN;
+    adjustment = std::max(-MAX_RATE_ADJUSTMENT, std::min(MAX_RATE_ADJUSTMENT, adjustment));
+    rateAdjustment = adjustment;
+    pacer.Adjust(1 + adjustment);
+}
+
+void Emulator::RunFrame() {
+    cpu.RunFrameUntil(CPU8080::MID_SCREEN_CYCLE);
+    ScanOut(0, VideoFrame::MID_SCREEN_LINE);
+    cpu.RunFrameUntil(CPU8080::CYCLES_PER_FRAME);
+}
+
+void Emulator::RunSlicedFrame(bool publishLines) {
+    for (int slice = 1; slice <= INPUT_SLICES; ++slice) {
+        ApplyInput();
+        uint64_t end = (uint64_t)CPU8080::CYCLES_PER_FRAME * slice / INPUT_SLICES;
+        if (cpu.frameOffset < CPU8080::MID_SCREEN_CYCLE && end >= CPU8080::MID_SCREEN_CYCLE) {
+            cpu.RunFrameUntil(CPU8080::MID_SCREEN_CYCLE);
+            ScanOut(0, VideoFrame::MID_SCREEN_LINE);
+            if (publishLines) PublishFrame(VideoFrame::MID_SCREEN_LINE); // The beam is past them: they are final
+        }
+        cpu.RunFrameUntil(end);
+        if (audio) audio->SetEmulatedCycle(cpu.cycles);
+        if (slice < INPUT_SLICES) pacer.WaitSlice(slice, INPUT_SLICES);
+    }
+}
+
+void Emulator::Run() {
+    if (perf) perf->Open(); // Counters belong to the thread that opens them
+
+    pacer.Reset();
+    smoothedLatency = audio ? audio->TargetLatency() : 0;
+    latencyErrorSum = 0;
+    speedStart = std::chrono::steady_clock::now();
+    speedFrames = cpu.frames;
+    bool wasTurbo = false;
+
+    while (running) {
+        bool turboFrame = turbo;
+        if (wasTurbo && !turboFrame) {
+            pacer.Reset(); // Back to real time from now on instead of catching up
+            publishInterval = 1;
+        }
+        wasTurbo = turboFrame;
+
+        if (perf) {
+            // Whole frames, so that the counters measure emulation and not the waits between slices
+            ApplyInput();
+            uint64_t instructions = cpu.instructions;
+            perf->Start();
+            RunFrame();
+            perf->Stop(cpu.instructions - instructions);
+        } else if (turboFrame) {
+            ApplyInput();
+            RunFrame();
+        } else {
+            RunSlicedFrame(runAhead == 0); // Run-ahead shows a later frame than this one
+        }
+        if (audio) audio->SetEmulatedCycle(cpu.cycles);
+        if (capture || screenExport) {
+            // Before run-ahead, which shows a later frame: these get the real ones
+            ScanOut(VideoFrame::MID_SCREEN_LINE, VideoFrame::LINES);
+            if (capture) capture->Submit(cpu.frames, scanOut);
+            if (screenExport) screenExport->Publish(cpu.frames, scanOut, cpu);
+        }
+        if (++unpublishedFrames >= publishInterval) {
+            int ahead = runAhead;
+            if (ahead > 0) {
+                PublishRunAhead(ahead);
+            } else {
+                PublishFrame();
+            }
+            unpublishedFrames = 0;
+        }
+
+        // Print CPU state
+        if (cpu.verbose) cpu.PrintState();
+
+        if (!turboFrame) {
+            if (audioSync) FollowAudioClock();
+            pacer.Wait();
+        }
+        MeasureSpeed(turboFrame);
+
+        if (cpu.frames % STATS_INTERVAL == 0) {
+            stats.Back() = pacer.Statistics();
+            stats.Publish();
+        }
+        if (frameLimit && cpu.frames >= frameLimit) running = false;
+    }
+}
@@ -0,0 +1,117 @@
+#ifndef EMULATOR_H
+#define EMULATOR_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <thread>
+#include "audio.h"
+#include "capture.h"
+#include "cpu.h"
+#include "frame.h"
+#include "frame_pacer.h"
+#include "perf_counters.h"
+#include "screen_export.h"
+#include "spsc_queue.h"
+#include "triple_buffer.h"
+
+// Button change sent from the UI thread to the emulation thread
+struct InputEvent {
+    uint8_t port; // 1 or 2
+    uint8_t mask; // Bits affected
+    bool pressed;
+    std::chrono::steady_clock::time_point received; // When the UI thread got it, for latency measurement
+};
+
+// Runs the CPU on its own thread at 60 (or 59.94) frames per second. Finished frames are
+// published through a triple buffer and input arrives through a queue, so the
+// emulation never waits for the display and the display never waits for it.
+class Emulator {
+public:
+    explicit Emulator(CPU8080& cpu);
+    ~Emulator();
+
+    void SetFrameRate(uint32_t numerator, uint32_t denominator); // Call before Start()
+    void SetDisplayRate(int hertz) { displayRate = hertz; } // Call before Start()
+    void SetRunAhead(int frames) { runAhead = frames; } // Show each frame this many frames ahead with the current input, 0 disables
+    void SetPerfCounters(PerfCounters* counters) { perf = counters; } // Count host events around RunFrame, call before Start()
+    // Report emulated time to the audio thread; with sync the frame deadlines follow the audio
+    // clock, each frame up to MAX_RATE_ADJUSTMENT faster or slower. Call before Start()
+    void SetAudio(Audio* output, bool sync) { audio = output; audioSync = sync; }
+    void SetCapture(Capture* recorder) { capture = recorder; } // Hand every finished frame to the capture, call before Start()
+    void SetScreenExport(ScreenExport* target) { screenExport = target; } // Publish every finished frame to shared memory, call before Start()
+    void SetFrameLimit(uint64_t frames) { frameLimit = frames; } // Stop once cpu.frames reaches it, 0 for no limit; call before Start()
+    void Start();
+    void Stop();
+
+    // UI thread
+    bool PushInput(const InputEvent& event); // False if the queue is full
+    const VideoFrame* LatestFrame(); // Newest frame or first lines of one, nullptr if none since the last call
+    FrameStats Statistics(); // Frame-time statistics, refreshed once a second
+    bool Running() const { return running; } // False once stopped or at the frame limit
+    void SetTurbo(bool enabled) { turbo = enabled; } // No frame cap, publishing every Nth frame at the display rate
+    bool Turbo() const { return turbo; }
+    double Speed() const { return speed; } // Emulated speed relative to real time
+    int RunAhead() const { return runAhead; }
+    double RunAheadCost() const { return runAheadCost; } // Extra milliseconds per published frame
+    double RateAdjustment() const { return rateAdjustment; } // Audio sync: current deviation from the nominal rate
+    uint64_t InputEvents() const { return inputEvents; } // Input events applied to the ports
+    double InputLatencyMean() const { return inputEvents ? inputLatencyTotal / inputEvents : 0; } // Milliseconds from receipt to port
+    double InputLatencyMax() const { return inputLatencyMax; }
+
+private:
+    void Run(); // Emulation thread main loop
+    void ApplyInput(); // Apply the queued input at the current cycle
+    void RunFrame(); // Run a whole frame, scanning out its first lines at the mid-screen interrupt
+    void RunSlicedFrame(bool publishLines); // Real time: INPUT_SLICES paced parts, input applied before each
+    void ScanOut(int first, int last); // Copy raster lines first to last - 1 from VRAM to scanOut, as the beam reaches them
+    void PublishFrame(int lines = VideoFrame::LINES); // LINES at VBlank, MID_SCREEN_LINE at the mid-screen interrupt
+    void PublishRunAhead(int count); // Publish the frame count frames ahead, then restore: hides the game's reaction delay
+    void MeasureSpeed(bool turboFrame); // Update the speed and the turbo publish interval
+    void FollowAudioClock(); // Audio sync: adjust the next frame deadline from the audio latency
+
+    static const int STATS_INTERVAL = 60; // Frames between statistics updates
+    static const int SPEED_INTERVAL_MS = 500; // Wall time between speed measurements
+    static const int INPUT_SLICES = 8; // Parts of a real-time frame with input applied before each
+    static constexpr double MAX_RATE_ADJUSTMENT = 0.005; // Audio sync: fastest or slowest, relative to nominal
+    static constexpr double RATE_GAIN = 0.5; // Audio sync: rate adjustment per second of latency error
+    static constexpr double DRIFT_GAIN = 0.05; // Audio sync: per second of latency error accumulated over a second, cancels clock drift
+    static constexpr double LATENCY_SMOOTHING = 0.05; // Audio sync: weight of each frame's latency sample
+
+    CPU8080& cpu;
+    std::thread thread;
+    std::atomic<bool> running;
+    std::atomic<bool> turbo;
+    std::atomic<double> speed;
+    std::atomic<int> runAhead;
+    std::atomic<double> runAheadCost;
+    std::atomic<double> rateAdjustment;
+    std::atomic<uint64_t> inputEvents;
+    std::atomic<double> inputLatencyTotal, inputLatencyMax;
+    int displayRate;
+    PerfCounters* perf; // Opened and used on the emulation thread, nullptr when off
+    Audio* audio; // nullptr without sound
+    bool audioSync;
+    Capture* capture; // nullptr when not capturing
+    ScreenExport* screenExport; // nullptr when not exporting
+    uint64_t frameLimit;
+
+    // Emulation thread only
+    int publishInterval; // Turbo: publish every Nth frame
+    int unpublishedFrames;
+    std::chrono::steady_clock::time_point speedStart;
+    uint64_t speedFrames; // cpu.frames at speedStart
+    CPUSnapshot runAheadState;
+    std::chrono::steady_clock::duration runAheadTime; // Spent running ahead since speedStart
+    uint64_t runAheadFrames; // Run-ahead frames published since speedStart
+    double smoothedLatency; // Audio sync: milliseconds
+    double latencyErrorSum; // Audio sync: latency error integrated over time, in seconds times seconds
+    uint8_t scanOut[VideoFrame::SIZE]; // VRAM as the beam showed it
+
+    FramePacer pacer;
+    TripleBuffer<VideoFrame> frames;
+    TripleBuffer<FrameStats> stats;
+    SpscQueue<InputEvent, 256> input;
+};
+
+#endif
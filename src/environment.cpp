@@ -0,0 +1,256 @@
+#include "environment.h"
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+// Port 1 bits
+static const uint8_t PORT1_COIN = 1 << 0;
+static const uint8_t PORT1_P1_START = 1 << 2;
+static const uint8_t PORT1_ALWAYS_ON = 1 << 3;
+static const uint8_t PORT1_P1_FIRE = 1 << 4;
+static const uint8_t PORT1_P1_LEFT = 1 << 5;
+static const uint8_t PORT1_P1_RIGHT = 1 << 6;
+
+// Work RAM locations used by the game
+static const uint16_t RAM_GAME_MODE = 0x20EF; // 1 while a game is running
+static const uint16_t RAM_P1_SCORE = 0x20F8; // Player 1 score, 2 BCD bytes, LSB first
+
+static const uint16_t VRAM_START = 0x2400;
+
+// Port 1 value for each action
+static const uint8_t ACTION_INPUTS[InvadersEnv::ACTION_COUNT] = {
+    0, // NOOP
+    PORT1_P1_FIRE, // FIRE
+    PORT1_P1_RIGHT, // RIGHT
+    PORT1_P1_LEFT, // LEFT
+    PORT1_P1_RIGHT | PORT1_P1_FIRE, // RIGHT_FIRE
+    PORT1_P1_LEFT | PORT1_P1_FIRE, // LEFT_FIRE
+};
+
+InvadersEnv::InvadersEnv(const char* rom1, const char* rom2, const char* rom3, const char* rom4,
+                         ObservationMode mode, int frameSkip)
+    : mode(mode), frameSkip(frameSkip), lastScore(0), observation(ObservationSize()) {
+    cpu.verbose = false;
+    cpu.LoadProgram(rom1, rom2, rom3, rom4);
+    if (!Boot()) {
+        std::cerr << "Error: The game did not start after inserting a coin; check the ROM files and the DIP switches"
+                  << std::endl;
+        exit(1);
+    }
+}
+
+size_t InvadersEnv::ObservationSize() const {
+    if (mode == OBSERVATION_DOWNSAMPLED) {
+        return DOWNSAMPLED_WIDTH * DOWNSAMPLED_HEIGHT;
+    }
+    return PACKED_SIZE;
+}
+
+int InvadersEnv::EnableHle() {
+    return cpu.EnableHle(false);
+}
+
+void InvadersEnv::PressButton(uint8_t bit, int frames) {
+    cpu.port1 = PORT1_ALWAYS_ON | bit;
+    for (int i = 0; i < frames; ++i) cpu.RunFrame();
+    cpu.port1 = PORT1_ALWAYS_ON;
+    for (int i = 0; i < frames; ++i) cpu.RunFrame();
+}
+
+bool InvadersEnv::Boot() {
+    // Let the ROM initialise and reach the attract mode
+    PressButton(0, 120);
+
+    // Insert a coin and start a one player game
+    PressButton(PORT1_COIN, 10);
+    PressButton(PORT1_P1_START, 10);
+
+    // Wait (bounded) for the game to actually begin
+    for (int i = 0; i < 600 && cpu.memory.Read(RAM_GAME_MODE) != 1; ++i) {
+        cpu.RunFrame();
+    }
+    if (cpu.memory.Read(RAM_GAME_MODE) != 1) return false;
+
+    cpu.SaveState(startState);
+    return true;
+}
+
+uint32_t InvadersEnv::Score() const {
+    uint32_t score = 0;
+    for (int i = 1; i >= 0; --i) {
+        uint8_t bcd = cpu.memory.Read(RAM_P1_SCORE + i);
+        score = score * 100 + (bcd >> 4) * 10 + (bcd & 0x0F);
+    }
+    return score;
+}
+
+void InvadersEnv::WriteObservation(uint8_t* out) const {
+    if (mode == OBSERVATION_PACKED) {
+        cpu.memory.CopyOut(VRAM_START, out, PACKED_SIZE);
+        return;
+    }
+
+    uint8_t vram[PACKED_SIZE];
+    cpu.memory.CopyOut(VRAM_START, vram, PACKED_SIZE);
+
+    // The screen is rotated: each 32-byte VRAM row is one column of the upright
+    // image, with bit 0 of the first byte at the bottom. Keep a pixel if any of
+    // the 2x2 block it represents is lit.
+    std::memset(out, 0, DOWNSAMPLED_WIDTH * DOWNSAMPLED_HEIGHT);
+    for (int x = 0; x < 224; ++x) {
+        const uint8_t* column = vram + x * 32;
+        uint8_t* dst = out + x / 2;
+        for (int byte = 0; byte < 32; ++byte) {
+            uint8_t bits = column[byte];
+            if (bits == 0) continue;
+            for (int bit = 0; bit < 8; ++bit) {
+                if (bits & (1 << bit)) {
+                    int y = 255 - (byte * 8 + bit);
+                    dst[(y / 2) * DOWNSAMPLED_WIDTH] = 255;
+                }
+            }
+        }
+    }
+}
+
+void InvadersEnv::Reset(uint8_t* out) {
+    cpu.LoadState(startState);
+    lastScore = Score();
+    WriteObservation(out);
+}
+
+const uint8_t* InvadersEnv::Reset() {
+    Reset(observation.data());
+    return observation.data();
+}
+
+StepResult InvadersEnv::Step(int action, uint8_t* out) {
+    if (action < 0 || action >= ACTION_COUNT) action = ACTION_NOOP;
+    cpu.port1 = PORT1_ALWAYS_ON | ACTION_INPUTS[action];
+
+    bool done = false;
+    for (int i = 0; i < frameSkip && !done; ++i) {
+        cpu.RunFrame();
+        done = cpu.memory.Read(RAM_GAME_MODE) != 1;
+    }
+
+    uint32_t score = Score();
+    StepResult result;
+    result.observation = out;
+    result.reward = (float)score - (float)lastScore;
+    result.done = done;
+    lastScore = score;
+
+    WriteObservation(out);
+    return result;
+}
+
+StepResult InvadersEnv::Step(int action) {
+    return Step(action, observation.data());
+}
+
+InvadersVecEnv::InvadersVecEnv(int count, const char* rom1, const char* rom2, const char* rom3, const char* rom4,
+                               InvadersEnv::ObservationMode mode, int frameSkip, int threads)
+    : batchActions(nullptr), batch(0), pending(0), stopping(false) {
+    if (count < 1) {
+        std::cerr << "Error: InvadersVecEnv needs at least one environment, got " << count << std::endl;
+        exit(1);
+    }
+
+    // Boot the ROM once and copy the booted environment; every copy starts from the same snapshot
+    envs.reserve(count);
+    envs.emplace_back(rom1, rom2, rom3, rom4, mode, frameSkip);
+    for (int i = 1; i < count; ++i) {
+        envs.push_back(envs[0]);
+    }
+
+    observations.resize(count * ObservationSize());
+    rewards.resize(count);
+    dones.resize(count);
+    ResetAll();
+
+    int ranges = threads < 1 ? 1 : threads < count ? threads : count;
+    perWorker = (count + ranges - 1) / ranges;
+    for (int begin = 0; begin + perWorker < count; begin += perWorker) {
+        workers.emplace_back(&InvadersVecEnv::Work, this, begin, begin + perWorker);
+    }
+}
+
+InvadersVecEnv::~InvadersVecEnv() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    batchReady.notify_all();
+    for (std::thread& worker : workers) {
+        worker.join();
+    }
+}
+
+int InvadersVecEnv::EnableHle() {
+    int enabled = 0;
+    for (InvadersEnv& env : envs) {
+        enabled += env.EnableHle();
+    }
+    return enabled;
+}
+
+void InvadersVecEnv::ResetAll() {
+    size_t size = ObservationSize();
+    for (int i = 0; i < Count(); ++i) {
+        envs[i].Reset(&observations[i * size]);
+        rewards[i] = 0;
+        dones[i] = 0;
+    }
+}
+
+void InvadersVecEnv::StepRange(const int* actions, int begin, int end) {
+    size_t size = ObservationSize();
+    for (int i = begin; i < end; ++i) {
+        uint8_t* slot = &observations[i * size];
+        StepResult result = envs[i].Step(actions[i], slot);
+        rewards[i] = result.reward;
+        dones[i] = result.done;
+        if (result.done) {
+            envs[i].Reset(slot);
+        }
+    }
+}
+
+void InvadersVecEnv::Work(int begin, int end) {
+    uint64_t done = 0; // Last batch this worker stepped
+    while (true) {
+        const int* actions;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            batchReady.wait(lock, [&] { return stopping || batch != done; });
+            if (stopping) return;
+            done = batch;
+            actions = batchActions;
+        }
+        StepRange(actions, begin, end);
+        std::lock_guard<std::mutex> lock(mutex);
+        if (--pending == 0) batchDone.notify_one();
+    }
+}
+
+void InvadersVecEnv::StepBatch(const int* actions) {
+    int count = Count();
+    if (workers.empty()) {
+        StepRange(actions, 0, count);
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        batchActions = actions;
+        pending = (int)workers.size();
+        ++batch;
+    }
+    batchReady.notify_all();
+
+    // The calling thread steps the last range while the workers step theirs
+    StepRange(actions, (int)workers.size() * perWorker, count);
+    std::unique_lock<std::mutex> lock(mutex);
+    batchDone.wait(lock, [&] { return pending == 0; });
+}
@@ -0,0 +1,111 @@
+#ifndef ENVIRONMENT_H
+#define ENVIRONMENT_H
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "cpu.h"
+
+// Result of advancing an environment by one step
+struct StepResult {
+    const uint8_t* observation; // Observation after the step
+    float reward; // Score gained during the step
+    bool done; // True when the game is over
+};
+
+// Reinforcement-learning environment built around CPU8080
+class InvadersEnv {
+public:
+    enum ObservationMode {
+        OBSERVATION_PACKED, // Raw 1bpp VRAM, 7168 bytes
+        OBSERVATION_DOWNSAMPLED // Upright 112x128 image, one byte per pixel (0 or 255)
+    };
+
+    enum Action {
+        ACTION_NOOP,
+        ACTION_FIRE,
+        ACTION_RIGHT,
+        ACTION_LEFT,
+        ACTION_RIGHT_FIRE,
+        ACTION_LEFT_FIRE,
+        ACTION_COUNT
+    };
+
+    static const int PACKED_SIZE = 0x1C00; // 224 rows of 32 bytes
+    static const int DOWNSAMPLED_WIDTH = 112;
+    static const int DOWNSAMPLED_HEIGHT = 128;
+
+    InvadersEnv(const char* rom1, const char* rom2, const char* rom3, const char* rom4,
+                ObservationMode mode = OBSERVATION_PACKED, int frameSkip = 4);
+
+    size_t ObservationSize() const; // Bytes per observation for the selected mode
+    int EnableHle(); // Opt-in native fast paths for known ROM routines (see hle.h)
+
+    const uint8_t* Reset(); // Restore the start-of-game snapshot and return the first observation
+    StepResult Step(int action); // Apply action for frameSkip frames
+
+    // Same as above but writing the observation into a caller-owned buffer
+    void Reset(uint8_t* observation);
+    StepResult Step(int action, uint8_t* observation);
+
+private:
+    bool Boot(); // Run the ROM through attract mode into a new game and take the snapshot, false if no game starts
+    void PressButton(uint8_t bit, int frames); // Hold a port 1 button for a number of frames
+    void WriteObservation(uint8_t* observation) const;
+    uint32_t Score() const; // Player 1 score decoded from BCD
+
+    CPU8080 cpu;
+    CPUSnapshot startState; // Snapshot restored by Reset()
+    ObservationMode mode;
+    int frameSkip;
+    uint32_t lastScore;
+    std::vector<uint8_t> observation; // Buffer returned by Reset() and Step(action)
+};
+
+// Advances many environments in one call. With threads > 1 the environments are split in
+// contiguous ranges, one per thread; the worker threads are started once and wait for each batch.
+class InvadersVecEnv {
+public:
+    InvadersVecEnv(int count, const char* rom1, const char* rom2, const char* rom3, const char* rom4,
+                   InvadersEnv::ObservationMode mode = InvadersEnv::OBSERVATION_PACKED, int frameSkip = 4,
+                   int threads = 1);
+    ~InvadersVecEnv();
+
+    int Count() const { return (int)envs.size(); }
+    size_t ObservationSize() const { return envs[0].ObservationSize(); }
+
+    // Observations of all environments in one contiguous block, Count() * ObservationSize() bytes.
+    // Step and reset write directly into it, so the pointer stays valid and nothing is copied out.
+    const uint8_t* Observations() const { return observations.data(); }
+    const float* Rewards() const { return rewards.data(); }
+    const uint8_t* Dones() const { return dones.data(); }
+
+    int EnableHle(); // Enable the HLE hooks in every environment, returns how many passed validation in total
+    void ResetAll();
+    // Step every environment with actions[i]; finished environments are reset automatically
+    void StepBatch(const int* actions);
+
+private:
+    void StepRange(const int* actions, int begin, int end);
+    void Work(int begin, int end); // Worker thread main loop: steps its range once per batch
+
+    std::vector<InvadersEnv> envs;
+    std::vector<uint8_t> observations;
+    std::vector<float> rewards;
+    std::vector<uint8_t> dones;
+    int perWorker; // Environments per range; the calling thread steps the last range
+
+    std::vector<std::thread> workers;
+    std::mutex mutex; // Guards the batch state below
+    std::condition_variable batchReady; // StepBatch to the workers
+    std::condition_variable batchDone; // Last worker to finish to StepBatch
+    const int* batchActions;
+    uint64_t batch; // Batches started, workers step when it changes
+    int pending; // Workers still stepping the current batch
+    bool stopping;
+};
+
+#endif
@@ -0,0 +1,23 @@
+#ifndef FRAME_H
+#define FRAME_H
+
+#include <cstdint>
+
+// A video frame: Space Invaders VRAM (0x2400 - 0x3FFF), 1 bit per pixel, 224 raster
+// lines of 32 bytes, rotated 90 degrees counter-clockwise on the monitor. Lines hold
+// VRAM as the beam scanned it: the first MID_SCREEN_LINE lines at the mid-screen
+// interrupt, the rest at VBlank. A frame published at the mid-screen interrupt has
+// only its first lines final.
+struct VideoFrame {
+    static const int VRAM_START = 0x2400;
+    static const int SIZE = 0x1C00;
+    static const int LINE_BYTES = 32;
+    static const int LINES = SIZE / LINE_BYTES;
+    static const int MID_SCREEN_LINE = 96; // Line the beam reaches when the mid-screen interrupt fires
+
+    uint64_t number; // Emulated frame number, the same for both publications of a frame
+    int lines; // Lines final: MID_SCREEN_LINE or LINES
+    uint8_t vram[SIZE];
+};
+
+#endif
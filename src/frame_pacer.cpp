@@ -0,0 +1,100 @@
+#include "frame_pacer.h"
+#include <algorithm>
+#include <thread>
+
+FramePacer::FramePacer(uint32_t rateNumerator, uint32_t rateDenominator)
+    : numerator(rateNumerator), denominator(rateDenominator) {
+    times.reserve(WINDOW);
+    Reset();
+}
+
+void FramePacer::SetRate(uint32_t rateNumerator, uint32_t rateDenominator) {
+    numerator = rateNumerator;
+    denominator = rateDenominator;
+    Reset();
+}
+
+void FramePacer::Reset() {
+    start = Clock::now();
+    lastFrame = start;
+    frame = 1;
+    frames = late = 0;
+    times.clear();
+    next = 0;
+}
+
+FramePacer::Clock::time_point FramePacer::Deadline(uint64_t index) const {
+    // index * 1e9 * denominator / numerator without overflow for any realistic run
+    uint64_t seconds = index * denominator / numerator;
+    uint64_t remainder = index * denominator % numerator;
+    uint64_t nanoseconds = seconds * 1000000000ull + remainder * 1000000000ull / numerator;
+    return start + std::chrono::nanoseconds(nanoseconds);
+}
+
+void FramePacer::Wait() {
+    Clock::time_point deadline = Deadline(frame);
+    Clock::time_point now = Clock::now();
+
+    if (now > deadline) {
+        late++;
+        // Too far behind (debugger, suspended machine): start a new schedule instead of rushing
+        if (now - deadline > (Deadline(MAX_LATE_FRAMES) - start)) {
+            start = now;
+            frame = 0;
+        }
+    } else {
+        auto remaining = deadline - now;
+        if (remaining > std::chrono::nanoseconds(SPIN_NANOSECONDS)) {
+            std::this_thread::sleep_for(remaining - std::chrono::nanoseconds(SPIN_NANOSECONDS));
+        }
+        while ((now = Clock::now()) < deadline) {
+            // Spin for the last stretch; sleep wake-up is too coarse
+        }
+    }
+
+    frame++;
+    Record(now);
+}
+
+void FramePacer::WaitSlice(int slice, int slices) {
+    Clock::time_point begin = Deadline(frame - 1);
+    std::this_thread::sleep_until(begin + (Deadline(frame) - begin) * slice / slices);
+}
+
+void FramePacer::Adjust(double factor) {
+    // Moving the start of the schedule moves every later deadline by the same amount
+    double period = 1e9 * denominator / numerator;
+    start += std::chrono::nanoseconds((int64_t)(period / factor - period));
+}
+
+void FramePacer::Record(Clock::time_point now) {
+    double milliseconds = std::chrono::duration<double, std::milli>(now - lastFrame).count();
+    lastFrame = now;
+    frames++;
+
+    if (times.size() < WINDOW) {
+        times.push_back(milliseconds);
+    } else {
+        times[next] = milliseconds;
+    }
+    next = (next + 1) % WINDOW;
+}
+
+FrameStats FramePacer::Statistics() const {
+    FrameStats stats;
+    stats.frames = frames;
+    stats.late = late;
+    if (times.empty()) return stats;
+
+    std::vector<double> sorted(times);
+    std::sort(sorted.begin(), sorted.end());
+
+    double sum = 0;
+    for (double time : sorted) sum += time;
+
+    stats.minimum = sorted.front();
+    stats.maximum = sorted.back();
+    stats.mean = sum / sorted.size();
+    stats.p99 = sorted[std::min(sorted.size() - 1, sorted.size() * 99 / 100)];
+    return stats;
+}
@@ -0,0 +1,55 @@
+#ifndef FRAME_PACER_H
+#define FRAME_PACER_H
+
+#include <chrono>
+#include <cstdint>
+#include <vector>
+
+// Frame-time statistics over the last FramePacer::WINDOW frames, in milliseconds
+struct FrameStats {
+    double minimum = 0;
+    double mean = 0;
+    double p99 = 0;
+    double maximum = 0;
+    uint64_t frames = 0; // Frames paced since the last reset
+    uint64_t late = 0; // Frames that missed their deadline
+};
+
+// Paces a loop to an exact frame rate using the monotonic clock.
+// Deadlines are computed from the start time and the frame index with integer
+// arithmetic, so rounding never accumulates (60000/1001 Hz stays 59.94 Hz).
+// Waiting sleeps until shortly before the deadline and spins the rest.
+class FramePacer {
+public:
+    static const int WINDOW = 600; // Frames kept for statistics (10 s at 60 Hz)
+
+    FramePacer(uint32_t rateNumerator = 60, uint32_t rateDenominator = 1);
+
+    void SetRate(uint32_t rateNumerator, uint32_t rateDenominator); // Frames per second as a fraction
+    double Rate() const { return (double)numerator / denominator; } // Frames per second
+    void Reset(); // Restart the schedule from now
+    void Wait(); // Block until the next frame deadline and record the frame time
+    void WaitSlice(int slice, int slices); // Sleep until slice/slices of the way to the next deadline
+    void Adjust(double factor); // Run the next frame at factor times the rate, for rate control against another clock
+
+    FrameStats Statistics() const;
+
+private:
+    typedef std::chrono::steady_clock Clock;
+
+    static constexpr int64_t SPIN_NANOSECONDS = 1500000; // Sleep granularity margin spent spinning
+    static const int MAX_LATE_FRAMES = 6; // Further behind than this, drop the backlog and resync
+
+    Clock::time_point Deadline(uint64_t frame) const;
+    void Record(Clock::time_point now);
+
+    uint32_t numerator, denominator;
+    Clock::time_point start; // Time of frame 0
+    uint64_t frame; // Index of the next deadline
+    Clock::time_point lastFrame;
+    uint64_t frames, late;
+    std::vector<double> times; // Ring buffer of frame times in milliseconds
+    size_t next;
+};
+
+#endif
@@ -1,4 +1,5 @@
 #include "graphics.h"
+#include <algorithm>
 #include <iostream>
 
 Graphics::Graphics() : window(nullptr), renderer(nullptr), texture(nullptr) {
@@ -18,22 +19,29 @@ void Graphics::Initialize() {
         exit(1);
     }
 
-    window = SDL_CreateWindow("Space Invaders", SDL_WINDOWPOS_UNDEFINED, SDL_WINDOWPOS_UNDEFINED, SCREEN_WIDTH * 2, SCREEN_HEIGHT * 2, SDL_WINDOW_SHOWN);
+    int windowScale = std::max(2, filter.Scale());
+    window = SDL_CreateWindow("Space Invaders", SDL_WINDOWPOS_UNDEFINED, SDL_WINDOWPOS_UNDEFINED, SCREEN_WIDTH * windowScale, SCREEN_HEIGHT * windowScale, SDL_WINDOW_SHOWN);
 
     if (!window) {
         std::cerr << "Error: Could not create window: " << SDL_GetError() << std::endl;
         exit(1);
     }
 
-    renderer = SDL_CreateRenderer(window, -1, SDL_RENDERER_ACCELERATED);
+    renderer = SDL_CreateRenderer(window, -1, SDL_RENDERER_ACCELERATED | SDL_RENDERER_PRESENTVSYNC);
     if (!renderer) {
         std::cerr << "Error: Could not create renderer: " << SDL_GetError() << std::endl;
         exit(1);
     }
 
     SDL_RenderSetLogicalSize(renderer, SCREEN_WIDTH, SCREEN_HEIGHT);
+    SDL_RenderSetIntegerScale(renderer, SDL_TRUE); // Resized windows show whole screen pixels
 
-    texture = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_RGB888, SDL_TEXTUREACCESS_STREAMING, SCREEN_WIDTH, SCREEN_HEIGHT);
+    CreateTexture();
+}
+
+void Graphics::CreateTexture() {
+    if (texture) SDL_DestroyTexture(texture);
+    texture = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_RGB888, SDL_TEXTUREACCESS_STREAMING, filter.Width(), filter.Height());
 
     if (!texture) {
         std::cerr << "Error: Could not create texture: " << SDL_GetError() << std::endl;
@@ -41,25 +49,45 @@ void Graphics::Initialize() {
     }
 }
 
-void Graphics::Clear() {
-    SDL_SetRenderDrawColor(renderer, 0, 0, 0, 255); // Clean to black colors
-    SDL_RenderClear(renderer);
+void Graphics::SetScale(int factor) {
+    filter.SetScale(factor);
+    if (!renderer) return; // Initialize() creates the window and texture at this scale
+    int windowScale = std::max(2, filter.Scale());
+    SDL_SetWindowSize(window, SCREEN_WIDTH * windowScale, SCREEN_HEIGHT * windowScale);
+    CreateTexture();
+}
+
+void Graphics::UpdateLines(const uint8_t* vram, int first, int count) {
+    if (count <= 0) return;
+    // Only the columns of these lines are locked, so the rest of the texture keeps its pixels
+    int scale = filter.Scale();
+    SDL_Rect columns = { first * scale, 0, count * scale, filter.Height() };
+    void* pixels;
+    int pitch;
+    if (SDL_LockTexture(texture, &columns, &pixels, &pitch) != 0) {
+        std::cerr << "Error: Could not lock texture: " << SDL_GetError() << std::endl;
+        return;
+    }
+
+    filter.Convert(vram, first, count, pixels, pitch);
+
+    SDL_UnlockTexture(texture);
 }
 
-void Graphics::DrawPixel(int x, int y) {
-    SDL_SetRenderDrawColor(renderer, 255, 255, 255, 255); // Set color to white
-    SDL_RenderDrawPoint(renderer, x, y);
+void Graphics::Present() {
+    SDL_RenderCopy(renderer, texture, nullptr, nullptr);
+    SDL_RenderPresent(renderer);
 }
 
-void Graphics::Update() {
-    SDL_RenderPresent(renderer); // Update the screen with the renderer content
+void Graphics::SetTitle(const char* title) {
+    SDL_SetWindowTitle(window, title);
 }
 
-void Graphics::HandleEvents(bool& running) {
-    SDL_Event event;
-    while (SDL_PollEvent(&event)) {
-        if (event.type == SDL_QUIT) {
-            running = false;
-        }
+int Graphics::RefreshRate() const {
+    SDL_DisplayMode mode;
+    int display = SDL_GetWindowDisplayIndex(window);
+    if (display < 0 || SDL_GetCurrentDisplayMode(display, &mode) != 0 || mode.refresh_rate <= 0) {
+        return 60;
     }
-}
\ No newline at end of file
+    return mode.refresh_rate;
+}
@@ -2,27 +2,35 @@
 #define GRAPHICS_H
 
 #include "SDL2/SDL.h"
+#include "display_filter.h"
 
 class Graphics {
 
 public:
+    static const int SCREEN_WIDTH = DisplayFilter::WIDTH; // Screen width
+    static const int SCREEN_HEIGHT = DisplayFilter::HEIGHT; // Screen height
+
     Graphics();
     ~Graphics();
 
     void Initialize(); // Initialize the graphics SDL2
-    void Clear(); // Clear the screen
-    void DrawPixel(int x, int y); // Draw a pixel on the screen
-    void Update(); // Update the screen
-    void HandleEvents(bool& running); // Handle SDL2 events
+    void UpdateLines(const uint8_t* vram, int first, int count); // Convert raster lines of a packed 1bpp VRAM frame into the texture
+    void Present(); // Show the texture, waiting for vsync
+    void SetOverlay(bool enabled) { filter.SetOverlay(enabled); } // Takes effect on the lines converted next
+    void SetScanlines(bool enabled) { filter.SetScanlines(enabled); }
+    void SetScale(int factor); // Recreates the texture and resizes the window; convert a whole frame next
+    const DisplayFilter& Filter() const { return filter; }
+    void SetTitle(const char* title); // Window title
+    int RefreshRate() const; // Refresh rate of the window's display in Hz, 60 if unknown
 
 private:
     SDL_Window* window;
     SDL_Renderer* renderer;
     SDL_Texture* texture;
-    
-    static const int SCREEN_WIDTH = 224; // Screen width
-    static const int SCREEN_HEIGHT = 256; // Screen height
+    DisplayFilter filter;
 
+    void CreateTexture(); // Sized for the filter's scale
+    
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,314 @@
+#include "hle.h"
+#include <cstring>
+#include <iostream>
+#include <vector>
+#include "cpu.h"
+
+static uint16_t GetHL(const CPU8080& cpu) { return (cpu.H << 8) | cpu.L; }
+static uint16_t GetDE(const CPU8080& cpu) { return (cpu.D << 8) | cpu.E; }
+static void SetHL(CPU8080& cpu, uint16_t value) { cpu.H = value >> 8; cpu.L = value & 0xFF; }
+static void SetDE(CPU8080& cpu, uint16_t value) { cpu.D = value >> 8; cpu.E = value & 0xFF; }
+
+// Iterations of a loop counted down in B (0 means 256)
+static int LoopCount(const CPU8080& cpu) {
+    return cpu.B ? cpu.B : 256;
+}
+
+// With interrupts enabled a hook must end by the next interrupt (see CPU8080::cycleLimit);
+// otherwise the routine is left to the interpreter
+static bool Fits(const CPU8080& cpu, uint64_t cycles) {
+    return !cpu.interruptsEnabled || cpu.cycles + cycles <= cpu.cycleLimit;
+}
+
+// Flags after the DCR B that leaves 1 in B, which ends every skipped iteration: only the
+// carry, set or kept by the iteration, varies
+static uint8_t LoopFlags(bool carry) {
+    return CPU8080::FLAG_ALWAYS_ON | CPU8080::FLAG_AUX_CARRY | (carry ? CPU8080::FLAG_CARRY : 0);
+}
+
+// The PUSH B of the last skipped iteration leaves B = 2 and C below the stack pointer
+static void LeaveLoopStack(CPU8080& cpu) {
+    cpu.memory.Write(cpu.SP - 1, 2);
+    cpu.memory.Write(cpu.SP - 2, cpu.C);
+}
+
+// 1A32 BlockCopy: copy B bytes from (DE) to (HL)
+//   LDAX D / MOV M,A / INX H / INX D / DCR B / JNZ 1A32 / RET
+static void BlockCopy(CPU8080& cpu) {
+    int count = LoopCount(cpu) - 1;
+    if (!Fits(cpu, count * (7 + 7 + 5 + 5 + 5 + 10))) return;
+    uint16_t source = GetDE(cpu);
+    uint16_t destination = GetHL(cpu);
+
+    if (count == 0) return;
+
+    // Byte by byte through Write, like MOV M,A: ROM stays protected, the addresses wrap at
+    // FFFF and an overlapping forward copy repeats the pattern
+    uint8_t last = 0;
+    for (int i = 0; i < count; ++i) {
+        last = cpu.memory.Read(source + i);
+        cpu.memory.Write(destination + i, last);
+    }
+
+    cpu.A = last;
+    cpu.flags = LoopFlags(cpu.flags & CPU8080::FLAG_CARRY);
+    SetDE(cpu, source + count);
+    SetHL(cpu, destination + count);
+    cpu.B = 1;
+    cpu.cycles += count * (7 + 7 + 5 + 5 + 5 + 10);
+}
+
+static void BlockCopySetup(CPU8080& cpu) {
+    cpu.B = 0x40;
+    SetDE(cpu, 0x1B00);
+    SetHL(cpu, 0x2100);
+}
+
+// 1A5C ClearScreen: zero VRAM from 2400 to 3FFF
+//   LXI H,2400 / loop: MVI M,0 / INX H / MOV A,H / CPI 40 / JNZ loop / RET
+static void ClearScreen(CPU8080& cpu) {
+    int count = 0x1C00 - 1;
+    if (!Fits(cpu, 10 + count * (10 + 5 + 5 + 7 + 10))) return;
+
+    for (int i = 0; i < count; ++i) {
+        cpu.memory.Write(0x2400 + i, 0);
+    }
+    SetHL(cpu, 0x2400 + count);
+    // MOV A,H / CPI 40 with H = 3F: borrow, sign, even parity and auxiliary carry
+    cpu.A = 0x3F;
+    cpu.flags = CPU8080::FLAG_ALWAYS_ON | CPU8080::FLAG_CARRY | CPU8080::FLAG_SIGN | CPU8080::FLAG_PARITY |
+                CPU8080::FLAG_AUX_CARRY;
+    cpu.PC = 0x1A5F;
+    cpu.cycles += 10 + count * (10 + 5 + 5 + 7 + 10);
+}
+
+// 1439 DrawSimpSprite: copy B bytes from (DE) to one VRAM column starting at HL
+//   PUSH B / LDAX D / MOV M,A / INX D / LXI B,0020 / DAD B / POP B / DCR B / JNZ 1439 / RET
+static void DrawSimpSprite(CPU8080& cpu) {
+    int count = LoopCount(cpu) - 1;
+    if (!Fits(cpu, count * (11 + 7 + 7 + 5 + 10 + 10 + 10 + 5 + 10))) return;
+    uint16_t source = GetDE(cpu);
+    uint16_t destination = GetHL(cpu);
+
+    if (count == 0) return;
+
+    for (int i = 0; i < count; ++i) {
+        cpu.A = cpu.memory.Read(source + i);
+        cpu.memory.Write(destination + i * 0x20, cpu.A);
+    }
+
+    cpu.flags = LoopFlags(destination + count * 0x20 > 0xFFFF); // Carry of the last DAD B
+    LeaveLoopStack(cpu);
+    SetDE(cpu, source + count);
+    SetHL(cpu, destination + count * 0x20);
+    cpu.B = 1;
+    cpu.cycles += count * (11 + 7 + 7 + 5 + 10 + 10 + 10 + 5 + 10);
+}
+
+static void DrawSimpSpriteSetup(CPU8080& cpu) {
+    cpu.B = 8;
+    SetDE(cpu, 0x1E00);
+    SetHL(cpu, 0x2C10);
+}
+
+// 14CB ClearSmallSprite: zero B bytes of one VRAM column starting at HL
+//   XRA A / loop: PUSH B / MOV M,A / LXI B,0020 / DAD B / POP B / DCR B / JNZ loop / RET
+static void ClearSmallSprite(CPU8080& cpu) {
+    int count = LoopCount(cpu) - 1;
+    if (!Fits(cpu, 4 + count * (11 + 7 + 10 + 10 + 10 + 5 + 10))) return;
+    uint16_t destination = GetHL(cpu);
+
+    if (count == 0) return;
+
+    for (int i = 0; i < count; ++i) {
+        cpu.memory.Write(destination + i * 0x20, 0);
+    }
+
+    cpu.A = 0;
+    cpu.flags = LoopFlags(destination + count * 0x20 > 0xFFFF); // Carry of the last DAD B
+    LeaveLoopStack(cpu);
+    SetHL(cpu, destination + count * 0x20);
+    cpu.B = 1;
+    cpu.PC = 0x14CC;
+    cpu.cycles += 4 + count * (11 + 7 + 10 + 10 + 10 + 5 + 10);
+}
+
+static void ClearSmallSpriteSetup(CPU8080& cpu) {
+    cpu.B = 16;
+    SetHL(cpu, 0x3010);
+}
+
+// How the shifted sprite routines combine the shift register output with the screen
+enum ShiftedBlend {
+    BLEND_COPY, // MOV M,A
+    BLEND_OR, // ORA M / MOV M,A
+    BLEND_ERASE, // CMA / ANA M / MOV M,A
+};
+
+// Shifted sprite routines: B rows of one byte from (DE) drawn at pixel HL through the
+// shift register, two screen bytes per row
+//   [PUSH H] loop: PUSH B / PUSH H / LDAX D / OUT 4 / IN 3 / blend / INX H / INX D /
+//   XRA A / OUT 4 / IN 3 / blend / POP H / LXI B,0020 / DAD B / POP B / DCR B / JNZ loop
+// They start with CALL 1474 CnvtPixNumber (MOV A,L / ANI 07 / OUT 2 / JMP 1A47), which
+// sets the shift amount and turns HL into a screen address (1A47 ConvToScr:
+// PUSH B / MVI B,3 / 3x rotate HL right / MOV A,H / ANI 3F / ORI 20 / MOV H,A / POP B / RET).
+// Each row goes through ShiftRegister::Shift in one call instead of four bus accesses.
+template <uint16_t LOOP, ShiftedBlend BLEND, bool SAVES_HL>
+static void DrawShifted(CPU8080& cpu) {
+    const int entryCycles = (LOOP == 0x1405 ? 4 + 4 : 0) + 17 + (SAVES_HL ? 11 : 0) +
+                            5 + 7 + 10 + 10 + 11 + 7 + 3 * (5 + 4 + 5 + 5 + 4 + 5 + 5 + 10) + 5 + 7 + 7 + 5 + 10 + 10;
+    const int blendCycles = BLEND == BLEND_OR ? 7 : BLEND == BLEND_ERASE ? 4 + 7 : 0;
+    const int rowCycles = 11 + 11 + 7 + 10 + 10 + 7 + 5 + 5 + 4 + 10 + 10 + 7 + 10 + 10 + 10 + 10 + 5 + 10 + 2 * blendCycles;
+    int count = LoopCount(cpu) - 1;
+    if (count == 0 || !Fits(cpu, entryCycles + count * rowCycles)) return;
+    if (cpu.io != &CPU8080::SpaceInvadersBus()) return; // Ports 2, 3 and 4 go to other devices
+
+    uint16_t source = GetDE(cpu);
+    uint16_t destination = 0x2000 | ((GetHL(cpu) >> 3) & 0x1FFF);
+    cpu.shifter.WriteOffset(cpu.L);
+
+    if (SAVES_HL) {
+        cpu.SP -= 2;
+        cpu.memory.Write(cpu.SP + 1, destination >> 8);
+        cpu.memory.Write(cpu.SP, destination & 0xFF);
+    }
+
+    uint16_t row = destination;
+    for (int i = 0; i < count; ++i) {
+        row = destination + i * 0x20;
+        uint8_t data[2] = { cpu.memory.Read(source + i), 0 };
+        uint8_t shifted[2];
+        cpu.shifter.Shift(data, shifted, 2);
+        for (int j = 0; j < 2; ++j) {
+            uint16_t address = row + j;
+            uint8_t screen = cpu.memory.Read(address);
+            cpu.A = BLEND == BLEND_OR ? shifted[j] | screen :
+                    BLEND == BLEND_ERASE ? ~shifted[j] & screen : shifted[j];
+            cpu.memory.Write(address, cpu.A);
+        }
+    }
+
+    cpu.flags = LoopFlags(destination + count * 0x20 > 0xFFFF); // Carry of the last DAD B
+    LeaveLoopStack(cpu);
+    cpu.memory.Write(cpu.SP - 3, row >> 8); // PUSH H of the last skipped row
+    cpu.memory.Write(cpu.SP - 4, row & 0xFF);
+    SetDE(cpu, source + count);
+    SetHL(cpu, destination + count * 0x20);
+    cpu.B = 1;
+    cpu.PC = LOOP;
+    cpu.cycles += entryCycles + count * rowCycles;
+}
+
+static void DrawShiftedSetup(CPU8080& cpu) {
+    cpu.B = 16;
+    SetDE(cpu, 0x1C00);
+    SetHL(cpu, 0x2C85); // Screen address 2590, shifted by 5
+}
+
+static const HleHook HOOKS[] = {
+    { "BlockCopy", 0x1A32, 9, 0x4188CC0E, BlockCopy, BlockCopySetup },
+    { "ClearScreen", 0x1A5C, 13, 0x4FC02E2D, ClearScreen, nullptr },
+    { "DrawSimpSprite", 0x1439, 14, 0x61476FBE, DrawSimpSprite, DrawSimpSpriteSetup },
+    { "ClearSmallSprite", 0x14CB, 13, 0xEC3F3FB3, ClearSmallSprite, ClearSmallSpriteSetup },
+    { "DrawShiftedSprite", 0x1400, 34, 0x2BFF3B16, DrawShifted<0x1405, BLEND_OR, false>, DrawShiftedSetup },
+    { "EraseShifted", 0x1452, 34, 0x61D00586, DrawShifted<0x1455, BLEND_ERASE, false>, DrawShiftedSetup },
+    { "DrawSprite", 0x15D3, 32, 0x3E37F11B, DrawShifted<0x15D7, BLEND_COPY, true>, DrawShiftedSetup },
+};
+static const int HOOK_COUNT = sizeof(HOOKS) / sizeof(HOOKS[0]);
+
+// Hook entered at each address, 1 + its index in HOOKS or 0, so a jump finds its hook in one lookup
+static const std::vector<uint8_t> HOOK_AT = [] {
+    std::vector<uint8_t> table(0x10000, 0);
+    for (int i = 0; i < HOOK_COUNT; ++i) table[HOOKS[i].address] = i + 1;
+    return table;
+}();
+
+static uint32_t Checksum(const CPU8080& cpu, uint16_t address, uint16_t length) {
+    uint32_t hash = 0x811C9DC5;
+    for (uint16_t i = 0; i < length; ++i) {
+        hash = (hash ^ cpu.memory.Read(address + i)) * 0x01000193;
+    }
+    return hash;
+}
+
+// Run from a pushed return address until the routine returns to it
+static bool RunToReturn(CPU8080& cpu, uint16_t returnAddress, uint16_t returnSP) {
+    for (int i = 0; i < 1000000; ++i) {
+        if (cpu.PC == returnAddress && cpu.SP == returnSP) return true;
+        cpu.EmulateCycle();
+    }
+    return false;
+}
+
+static bool SameState(const CPU8080& a, const CPU8080& b) {
+    if (a.A != b.A || a.B != b.B || a.C != b.C || a.D != b.D || a.E != b.E || a.H != b.H || a.L != b.L ||
+        a.flags != b.flags || a.SP != b.SP || a.PC != b.PC || a.cycles != b.cycles) {
+        return false;
+    }
+    // Devices the routines drive through OUT, such as the shift register of the sprite routines
+    if (a.shifter.value != b.shifter.value || a.shifter.offset != b.shifter.offset || a.sound.bank1 != b.sound.bank1 ||
+        a.sound.bank2 != b.sound.bank2 || a.watchdog.kicks != b.watchdog.kicks) {
+        return false;
+    }
+
+    static uint8_t memoryA[0x10000], memoryB[0x10000];
+    a.memory.CopyOut(0x0000, memoryA, sizeof(memoryA));
+    b.memory.CopyOut(0x0000, memoryB, sizeof(memoryB));
+    return std::memcmp(memoryA, memoryB, sizeof(memoryA)) == 0;
+}
+
+// Differential test: call the routine once interpreted and once through the hook
+static bool MatchesInterpreter(const CPU8080& cpu, int hook) {
+    CPU8080 machine = cpu.Fork();
+    machine.hleHooks = 0;
+    machine.verbose = false;
+    machine.idleSkipping = false;
+    machine.interruptsEnabled = false;
+    machine.halted = false;
+
+    // Pretend the routine was called from a RAM address it never touches
+    const uint16_t returnAddress = 0x23F0;
+    machine.SP = 0x2400;
+    machine.memory.Write(machine.SP - 1, returnAddress >> 8);
+    machine.memory.Write(machine.SP - 2, returnAddress & 0xFF);
+    machine.SP -= 2;
+    machine.PC = HOOKS[hook].address;
+    if (HOOKS[hook].setup) HOOKS[hook].setup(machine);
+
+    CPU8080 interpreted = machine.Fork();
+    CPU8080 native = machine.Fork();
+
+    if (!RunToReturn(interpreted, returnAddress, 0x2400)) return false;
+
+    HOOKS[hook].run(native);
+    if (!RunToReturn(native, returnAddress, 0x2400)) return false;
+
+    return SameState(interpreted, native);
+}
+
+uint32_t ValidateHleHooks(const CPU8080& cpu, bool report) {
+    uint32_t mask = 0;
+    for (int i = 0; i < HOOK_COUNT; ++i) {
+        const HleHook& hook = HOOKS[i];
+        const char* status = "ok";
+
+        if (Checksum(cpu, hook.address, hook.length) != hook.checksum) {
+            status = "disabled, ROM checksum mismatch";
+        } else if (!MatchesInterpreter(cpu, i)) {
+            status = "disabled, differs from the interpreter";
+        } else {
+            mask |= 1u << i;
+        }
+
+        if (report) {
+            std::cout << "HLE hook " << hook.name << " at 0x" << std::hex << hook.address << std::dec
+                      << ": " << status << std::endl;
+        }
+    }
+    return mask;
+}
+
+void RunHleHook(CPU8080& cpu, uint32_t mask) {
+    int hook = HOOK_AT[cpu.PC] - 1;
+    if (hook >= 0 && (mask & (1u << hook))) HOOKS[hook].run(cpu);
+}
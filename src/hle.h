@@ -0,0 +1,33 @@
+#ifndef HLE_H
+#define HLE_H
+
+#include <cstdint>
+
+class CPU8080;
+
+// High-level emulation of known Space Invaders ROM subroutines.
+//
+// A hook replaces the bulk of a routine's loop with host code and leaves the
+// CPU at the start of the loop's final iteration, charging the cycles of the
+// iterations it skipped. Registers, flags and memory are then exactly as the
+// interpreter leaves them after the same iterations, so lockstep comparisons
+// (tools/lockstep.cpp) hold even inside the routine. The interpreter runs the
+// last iteration and the RET.
+struct HleHook {
+    const char* name;
+    uint16_t address; // Entry point intercepted on CALL and JMP
+    uint16_t length; // Bytes of ROM code covered by the checksum
+    uint32_t checksum; // FNV-1a of those bytes in the supported ROM
+    void (*run)(CPU8080& cpu); // Native fast path
+    void (*setup)(CPU8080& cpu); // Representative arguments for the differential test, nullptr if it takes none
+};
+
+// Validate every hook against the ROM loaded in cpu and return a mask of the
+// ones that passed. A hook passes when its code matches the checksum and the
+// native path leaves the machine in the same state as the interpreter.
+uint32_t ValidateHleHooks(const CPU8080& cpu, bool report);
+
+// Run the hook at cpu.PC if it is enabled in mask
+void RunHleHook(CPU8080& cpu, uint32_t mask);
+
+#endif
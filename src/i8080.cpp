@@ -0,0 +1,133 @@
+#include "i8080.h"
+#include <new>
+#include <vector>
+#include "cpu.h"
+
+struct i8080_machine {
+    CPU8080 cpu;
+    std::vector<uint8_t> rom;
+    unsigned options = I8080_OPTION_IDLE_SKIPPING;
+    uint8_t framebuffer[I8080_FRAMEBUFFER_SIZE];
+};
+
+struct i8080_snapshot {
+    CPUSnapshot state;
+};
+
+static_assert(I8080_ROM_SIZE == CPU8080::ROM_SIZE, "ROM size differs from the core");
+
+// Run body and turn any exception into an error code: none may reach a C caller
+template <class Body>
+static int Guard(Body body) {
+    try {
+        body();
+        return I8080_OK;
+    } catch (const std::bad_alloc&) {
+        return I8080_ERROR_OUT_OF_MEMORY;
+    } catch (...) {
+        return I8080_ERROR_INTERNAL;
+    }
+}
+
+// Options need the ROM in memory: superinstructions pre-decode it and HLE hooks validate against it
+static unsigned ApplyOptions(i8080_machine* machine) {
+    CPU8080& cpu = machine->cpu;
+    unsigned applied = machine->options & (I8080_OPTION_IDLE_SKIPPING | I8080_OPTION_SUPERINSTRUCTIONS);
+    cpu.idleSkipping = machine->options & I8080_OPTION_IDLE_SKIPPING;
+    cpu.EnableSuperinstructions(machine->options & I8080_OPTION_SUPERINSTRUCTIONS);
+    cpu.hleHooks = 0;
+    if ((machine->options & I8080_OPTION_HLE) && cpu.EnableHle(false) > 0) {
+        applied |= I8080_OPTION_HLE;
+    }
+    return applied;
+}
+
+int i8080_api_version(void) {
+    return I8080_API_VERSION;
+}
+
+i8080_machine* i8080_create(void) {
+    i8080_machine* machine = nullptr;
+    Guard([&] { machine = new i8080_machine; }); // The core allocates in its constructors too
+    if (machine) machine->cpu.verbose = false;
+    return machine;
+}
+
+void i8080_destroy(i8080_machine* machine) {
+    delete machine;
+}
+
+int i8080_load_rom(i8080_machine* machine, const uint8_t* rom, size_t size) {
+    if (size > I8080_ROM_SIZE) return I8080_ERROR_ROM_TOO_LARGE;
+    int result = Guard([&] { machine->rom.assign(rom, rom + size); });
+    return result == I8080_OK ? i8080_reset(machine) : result;
+}
+
+int i8080_reset(i8080_machine* machine) {
+    return Guard([&] {
+        CPU8080& cpu = machine->cpu;
+        cpu.Reset();
+        cpu.LoadRom(machine->rom.data(), machine->rom.size());
+        ApplyOptions(machine);
+    });
+}
+
+unsigned i8080_set_options(i8080_machine* machine, unsigned options) {
+    machine->options = options;
+    unsigned applied = 0;
+    if (Guard([&] { applied = ApplyOptions(machine); }) != I8080_OK) {
+        // Nothing here allocates
+        machine->options = 0;
+        machine->cpu.idleSkipping = false;
+        machine->cpu.EnableSuperinstructions(false);
+        machine->cpu.hleHooks = 0;
+    }
+    return applied;
+}
+
+int i8080_run_frame(i8080_machine* machine) {
+    return Guard([&] { machine->cpu.RunFrame(); });
+}
+
+void i8080_set_inputs(i8080_machine* machine, uint8_t port1, uint8_t port2) {
+    machine->cpu.port1 = port1;
+    machine->cpu.port2 = port2;
+}
+
+const uint8_t* i8080_framebuffer(i8080_machine* machine) {
+    // VRAM spans several pages, so it is gathered into one block
+    machine->cpu.memory.CopyOut(0x2400, machine->framebuffer, I8080_FRAMEBUFFER_SIZE);
+    return machine->framebuffer;
+}
+
+uint64_t i8080_frame_count(const i8080_machine* machine) {
+    return machine->cpu.frames;
+}
+
+uint64_t i8080_cycles(const i8080_machine* machine) {
+    return machine->cpu.cycles;
+}
+
+void i8080_read_memory(const i8080_machine* machine, uint16_t address, uint8_t* data, size_t len) {
+    for (size_t i = 0; i < len; ++i) {
+        data[i] = machine->cpu.memory.Read(address + i);
+    }
+}
+
+i8080_snapshot* i8080_snapshot_create(void) {
+    i8080_snapshot* snapshot = nullptr;
+    Guard([&] { snapshot = new i8080_snapshot; });
+    return snapshot;
+}
+
+void i8080_snapshot_destroy(i8080_snapshot* snapshot) {
+    delete snapshot;
+}
+
+int i8080_save(const i8080_machine* machine, i8080_snapshot* snapshot) {
+    return Guard([&] { machine->cpu.SaveState(snapshot->state); });
+}
+
+int i8080_restore(i8080_machine* machine, const i8080_snapshot* snapshot) {
+    return Guard([&] { machine->cpu.LoadState(snapshot->state); });
+}
@@ -0,0 +1,94 @@
+#ifndef I8080_H
+#define I8080_H
+
+/*
+ * libi8080: the Intel 8080 core and the Space Invaders machine (memory, shift
+ * hardware, input ports, interrupts) behind a C API, for embedding in other
+ * processes. No SDL and no window system: video is read from the framebuffer.
+ *
+ * Every function taking a machine must not be called on the same machine from
+ * two threads at once; different machines are independent.
+ *
+ * No C++ exception leaves the library: the functions that can fail (the core
+ * allocates memory pages as they are written) return an I8080_ERROR_* code.
+ * After an error the machine is consistent but its emulated state is
+ * unspecified until i8080_reset or i8080_restore succeeds.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#if defined(__GNUC__)
+#define I8080_API __attribute__((visibility("default")))
+#else
+#define I8080_API
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define I8080_API_VERSION 1 /* Bumped on incompatible changes */
+
+/* Return codes */
+#define I8080_OK 0
+#define I8080_ERROR_ROM_TOO_LARGE -1
+#define I8080_ERROR_OUT_OF_MEMORY -2
+#define I8080_ERROR_INTERNAL -3 /* Any other failure inside the core */
+
+#define I8080_ROM_SIZE 0x2000 /* invaders.h, .g, .f and .e concatenated */
+#define I8080_FRAMEBUFFER_SIZE 0x1C00 /* VRAM 0x2400 - 0x3FFF: 224 rows of 32 bytes, 1 bit per pixel */
+
+/* Port 1 bits (i8080_set_inputs) */
+#define I8080_PORT1_COIN 0x01
+#define I8080_PORT1_P2_START 0x02
+#define I8080_PORT1_P1_START 0x04
+#define I8080_PORT1_ALWAYS_ON 0x08
+#define I8080_PORT1_P1_FIRE 0x10
+#define I8080_PORT1_P1_LEFT 0x20
+#define I8080_PORT1_P1_RIGHT 0x40
+
+/* Options (i8080_set_options) */
+#define I8080_OPTION_IDLE_SKIPPING 0x01 /* Fast-forward idle polling loops, on by default */
+#define I8080_OPTION_SUPERINSTRUCTIONS 0x02 /* Fused dispatch of hot instruction sequences */
+#define I8080_OPTION_HLE 0x04 /* Native fast paths for validated ROM routines */
+
+typedef struct i8080_machine i8080_machine;
+typedef struct i8080_snapshot i8080_snapshot;
+
+I8080_API int i8080_api_version(void);
+
+/* Return NULL when out of memory */
+I8080_API i8080_machine* i8080_create(void);
+I8080_API void i8080_destroy(i8080_machine* machine);
+
+/* Power on with a ROM image of at most I8080_ROM_SIZE bytes */
+I8080_API int i8080_load_rom(i8080_machine* machine, const uint8_t* rom, size_t size);
+/* Power on again with the loaded ROM */
+I8080_API int i8080_reset(i8080_machine* machine);
+/* Returns the options that could be enabled (HLE hooks need a ROM that passes validation);
+   on an error every option is left off and 0 is returned */
+I8080_API unsigned i8080_set_options(i8080_machine* machine, unsigned options);
+
+/* Emulate one 60 Hz frame, including the mid-screen and VBlank interrupts */
+I8080_API int i8080_run_frame(i8080_machine* machine);
+I8080_API void i8080_set_inputs(i8080_machine* machine, uint8_t port1, uint8_t port2);
+
+/* VRAM after the last frame, I8080_FRAMEBUFFER_SIZE bytes; valid until the next call on the machine */
+I8080_API const uint8_t* i8080_framebuffer(i8080_machine* machine);
+I8080_API uint64_t i8080_frame_count(const i8080_machine* machine);
+I8080_API uint64_t i8080_cycles(const i8080_machine* machine);
+/* Read len bytes of the address space starting at address, wrapping at 64KB */
+I8080_API void i8080_read_memory(const i8080_machine* machine, uint16_t address, uint8_t* data, size_t len);
+
+/* Snapshots share memory pages copy-on-write with the machine: saving and restoring are cheap */
+I8080_API i8080_snapshot* i8080_snapshot_create(void);
+I8080_API void i8080_snapshot_destroy(i8080_snapshot* snapshot);
+I8080_API int i8080_save(const i8080_machine* machine, i8080_snapshot* snapshot);
+I8080_API int i8080_restore(i8080_machine* machine, const i8080_snapshot* snapshot);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
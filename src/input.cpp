@@ -0,0 +1,203 @@
+#include "input.h"
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+
+const Input::ControlBits Input::CONTROLS[CONTROL_COUNT] = {
+    { "coin", 1, 0x01 },
+    { "p1_start", 1, 0x04 },
+    { "p2_start", 1, 0x02 },
+    { "p1_fire", 1, 0x10 },
+    { "p1_left", 1, 0x20 },
+    { "p1_right", 1, 0x40 },
+    { "p2_fire", 2, 0x10 },
+    { "p2_left", 2, 0x20 },
+    { "p2_right", 2, 0x40 },
+    { "tilt", 2, 0x04 },
+};
+
+static const uint8_t PORT1_ALWAYS_ON = 0x08;
+static const uint8_t DIP_SHIPS = 0x03; // Port 2: ships per game minus 3
+static const uint8_t DIP_EXTRA_SHIP_1000 = 0x08; // Port 2: extra ship at 1000 points instead of 1500
+static const uint8_t DIP_COIN_INFO_OFF = 0x80; // Port 2: no coin information in the attract screen
+
+Input::Input() : dipSwitches(0) {
+    for (int i = 0; i < MAX_CONTROLLERS; ++i) {
+        controllers[i] = nullptr;
+        stick[i] = 0;
+    }
+
+    Bind(false, SDLK_c, COIN);
+    Bind(false, SDLK_1, P1_START);
+    Bind(false, SDLK_RETURN, P1_START);
+    Bind(false, SDLK_2, P2_START);
+    Bind(false, SDLK_SPACE, P1_FIRE);
+    Bind(false, SDLK_LEFT, P1_LEFT);
+    Bind(false, SDLK_RIGHT, P1_RIGHT);
+    Bind(false, SDLK_w, P2_FIRE);
+    Bind(false, SDLK_a, P2_LEFT);
+    Bind(false, SDLK_d, P2_RIGHT);
+    Bind(false, SDLK_t, TILT);
+
+    Bind(true, SDL_CONTROLLER_BUTTON_BACK, COIN);
+    Bind(true, SDL_CONTROLLER_BUTTON_START, P1_START);
+    Bind(true, SDL_CONTROLLER_BUTTON_A, P1_FIRE);
+    Bind(true, SDL_CONTROLLER_BUTTON_DPAD_LEFT, P1_LEFT);
+    Bind(true, SDL_CONTROLLER_BUTTON_DPAD_RIGHT, P1_RIGHT);
+}
+
+Input::~Input() {
+    for (SDL_GameController* controller : controllers) {
+        if (controller) SDL_GameControllerClose(controller);
+    }
+}
+
+void Input::Initialize() {
+    if (SDL_InitSubSystem(SDL_INIT_GAMECONTROLLER) < 0) {
+        std::cerr << "Warning: No game controller support: " << SDL_GetError() << std::endl;
+        return;
+    }
+    // Controllers connected at startup also arrive as SDL_CONTROLLERDEVICEADDED events
+}
+
+void Input::Bind(bool controller, int code, Control control) {
+    for (size_t i = 0; i < bindings.size(); ++i) {
+        if (bindings[i].controller == controller && bindings[i].code == code) {
+            bindings.erase(bindings.begin() + i);
+            break;
+        }
+    }
+    if (control != NONE) bindings.push_back({ controller, code, control });
+}
+
+void Input::LoadConfig(const char* path) {
+    std::ifstream file(path);
+    if (!file.is_open()) {
+        std::cerr << "Error: Could not open file " << path << std::endl;
+        exit(1);
+    }
+
+    std::string line;
+    for (int number = 1; std::getline(file, line); ++number) {
+        line = line.substr(0, line.find('#'));
+        std::istringstream fields(line);
+        std::string kind, name, value;
+        if (!(fields >> kind)) continue;
+        fields >> name >> value;
+
+        bool valid = false;
+        if (kind == "key" || kind == "button") {
+            Control control = value == "none" ? NONE : CONTROL_COUNT;
+            for (int i = 0; i < CONTROL_COUNT; ++i) {
+                if (value == CONTROLS[i].name) control = (Control)i;
+            }
+            int code = kind == "key" ? SDL_GetKeyFromName(name.c_str()) : SDL_GameControllerGetButtonFromString(name.c_str());
+            valid = control != CONTROL_COUNT && (kind == "key" ? code != SDLK_UNKNOWN : code >= 0);
+            if (valid) Bind(kind == "button", code, control);
+        } else if (kind == "dip" && name == "ships") {
+            int ships = std::atoi(value.c_str());
+            valid = ships >= 3 && ships <= 6;
+            if (valid) dipSwitches = (dipSwitches & ~DIP_SHIPS) | (ships - 3);
+        } else if (kind == "dip" && name == "extra_ship") {
+            valid = value == "1000" || value == "1500";
+            if (valid) dipSwitches = value == "1000" ? dipSwitches | DIP_EXTRA_SHIP_1000 : dipSwitches & ~DIP_EXTRA_SHIP_1000;
+        } else if (kind == "dip" && name == "coin_info") {
+            valid = value == "on" || value == "off";
+            if (valid) dipSwitches = value == "off" ? dipSwitches | DIP_COIN_INFO_OFF : dipSwitches & ~DIP_COIN_INFO_OFF;
+        }
+
+        if (!valid) {
+            std::cerr << "Error: " << path << ":" << number << ": invalid entry: " << line << std::endl;
+            exit(1);
+        }
+    }
+}
+
+uint8_t Input::InitialPort1() const {
+    return PORT1_ALWAYS_ON;
+}
+
+void Input::Send(Emulator& emulator, Control control, bool pressed) {
+    InputEvent event = { CONTROLS[control].port, CONTROLS[control].mask, pressed, std::chrono::steady_clock::now() };
+    emulator.PushInput(event); // A full queue drops the change, as a missed poll would
+}
+
+int Input::Player(int32_t instance) const {
+    for (int i = 0; i < MAX_CONTROLLERS; ++i) {
+        if (controllers[i] && SDL_JoystickInstanceID(SDL_GameControllerGetJoystick(controllers[i])) == instance) return i;
+    }
+    return -1;
+}
+
+Input::Control Input::ForPlayer(Control control, int player) {
+    if (player == 0) return control;
+    switch (control) {
+        case P1_START: return P2_START;
+        case P1_FIRE: return P2_FIRE;
+        case P1_LEFT: return P2_LEFT;
+        case P1_RIGHT: return P2_RIGHT;
+        default: return control;
+    }
+}
+
+bool Input::Handle(const SDL_Event& event, Emulator& emulator) {
+    switch (event.type) {
+        case SDL_KEYDOWN:
+        case SDL_KEYUP:
+            if (event.key.repeat) return false;
+            for (const Binding& binding : bindings) {
+                if (!binding.controller && binding.code == event.key.keysym.sym) {
+                    Send(emulator, binding.control, event.type == SDL_KEYDOWN);
+                    return true;
+                }
+            }
+            return false;
+
+        case SDL_CONTROLLERBUTTONDOWN:
+        case SDL_CONTROLLERBUTTONUP: {
+            int player = Player(event.cbutton.which);
+            if (player < 0) return false;
+            for (const Binding& binding : bindings) {
+                if (binding.controller && binding.code == event.cbutton.button) {
+                    Send(emulator, ForPlayer(binding.control, player), event.type == SDL_CONTROLLERBUTTONDOWN);
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        case SDL_CONTROLLERAXISMOTION: {
+            int player = Player(event.caxis.which);
+            if (player < 0 || event.caxis.axis != SDL_CONTROLLER_AXIS_LEFTX) return false;
+            int direction = event.caxis.value < -STICK_THRESHOLD ? -1 : event.caxis.value > STICK_THRESHOLD ? 1 : 0;
+            if (direction == stick[player]) return true;
+            if (stick[player]) Send(emulator, ForPlayer(stick[player] < 0 ? P1_LEFT : P1_RIGHT, player), false);
+            if (direction) Send(emulator, ForPlayer(direction < 0 ? P1_LEFT : P1_RIGHT, player), true);
+            stick[player] = direction;
+            return true;
+        }
+
+        case SDL_CONTROLLERDEVICEADDED:
+            // which is the device index here
+            for (int i = 0; i < MAX_CONTROLLERS; ++i) {
+                if (!controllers[i]) {
+                    controllers[i] = SDL_GameControllerOpen(event.cdevice.which);
+                    break;
+                }
+            }
+            return true;
+
+        case SDL_CONTROLLERDEVICEREMOVED: {
+            int player = Player(event.cdevice.which);
+            if (player >= 0) {
+                SDL_GameControllerClose(controllers[player]);
+                controllers[player] = nullptr;
+                stick[player] = 0;
+            }
+            return true;
+        }
+    }
+    return false;
+}
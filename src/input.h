@@ -0,0 +1,65 @@
+#ifndef INPUT_H
+#define INPUT_H
+
+#include <cstdint>
+#include <vector>
+#include "SDL2/SDL.h"
+#include "emulator.h"
+
+// Keyboard and game controller input for every bit of ports 1 and 2. Events are
+// translated through a binding table (defaults below, changed with a configuration
+// file) into port bit changes for the emulation thread, stamped with the time they
+// were received. The first controller plays player 1, the second player 2.
+//
+// Configuration file, one entry per line, # starts a comment:
+//   key <SDL key name> <control>        e.g. key Space p1_fire, key 5 coin, key Return none
+//   button <SDL button name> <control>  e.g. button a p1_fire, button back coin (player 1)
+//   dip ships 3|4|5|6
+//   dip extra_ship 1000|1500
+//   dip coin_info on|off
+// Controls: coin, p1_start, p2_start, p1_fire, p1_left, p1_right, p2_fire, p2_left,
+// p2_right, tilt, or none to remove the binding.
+class Input {
+public:
+    Input();
+    ~Input();
+
+    void Initialize(); // Open the controllers already connected
+    void LoadConfig(const char* path);
+
+    // Translate an event for the emulator: true if it was a bound key, button or stick move
+    bool Handle(const SDL_Event& event, Emulator& emulator);
+
+    uint8_t InitialPort1() const; // Bit 3 always reads 1
+    uint8_t InitialPort2() const { return dipSwitches; }
+
+private:
+    enum Control { COIN, P1_START, P2_START, P1_FIRE, P1_LEFT, P1_RIGHT, P2_FIRE, P2_LEFT, P2_RIGHT, TILT, CONTROL_COUNT, NONE };
+    struct ControlBits {
+        const char* name;
+        uint8_t port;
+        uint8_t mask;
+    };
+    static const ControlBits CONTROLS[CONTROL_COUNT];
+
+    struct Binding {
+        bool controller; // Controller button, otherwise key
+        int code; // SDL_Keycode or SDL_GameControllerButton
+        Control control;
+    };
+
+    static const int MAX_CONTROLLERS = 2;
+    static const int STICK_THRESHOLD = 12000; // Left stick deflection that counts as left or right
+
+    void Bind(bool controller, int code, Control control);
+    void Send(Emulator& emulator, Control control, bool pressed);
+    int Player(int32_t instance) const; // Player of a controller event, -1 if not one of ours
+    static Control ForPlayer(Control control, int player); // Player 1 control as played by player 2
+
+    std::vector<Binding> bindings;
+    uint8_t dipSwitches; // Port 2 bits 0, 1, 3 and 7
+    SDL_GameController* controllers[MAX_CONTROLLERS];
+    int stick[MAX_CONTROLLERS]; // Left stick: -1 left, 0 centred, 1 right
+};
+
+#endif
@@ -0,0 +1,59 @@
+#ifndef IO_BUS_H
+#define IO_BUS_H
+
+#include <cstdint>
+
+// Port map of a machine: 256 input and 256 output handlers. Each handler is a plain
+// function instantiated for one device method, so the method is inlined into it and
+// IN or OUT costs a single indirect call. Handlers reach the device through the
+// machine, which owns it, so one bus serves every copy of a machine. Unmapped inputs
+// read 0 and unmapped outputs are ignored.
+template <class Machine>
+class IoBus {
+public:
+    typedef uint8_t (*InputHandler)(Machine& machine);
+    typedef void (*OutputHandler)(Machine& machine, uint8_t value);
+
+    IoBus() {
+        for (int port = 0; port < 256; ++port) {
+            inputs[port] = &OpenBus;
+            outputs[port] = &Ignore;
+        }
+    }
+
+    // Input answered by a device: DEVICE is a member of Machine, READ a method uint8_t Device::Read()
+    template <auto DEVICE, auto READ>
+    void MapInput(uint8_t port) { inputs[port] = &ReadDevice<DEVICE, READ>; }
+
+    // Output sent to a device: WRITE is a method void Device::Write(uint8_t value)
+    template <auto DEVICE, auto WRITE>
+    void MapOutput(uint8_t port) { outputs[port] = &WriteDevice<DEVICE, WRITE>; }
+
+    // Output handled by a function of the machine, for devices that need more of it than their own state
+    void MapOutput(uint8_t port, OutputHandler handler) { outputs[port] = handler; }
+
+    // Input that reads a byte of the machine directly, such as a button latch
+    template <uint8_t Machine::*LATCH>
+    void MapLatch(uint8_t port) { inputs[port] = &ReadLatch<LATCH>; }
+
+    uint8_t Read(Machine& machine, uint8_t port) const { return inputs[port](machine); }
+    void Write(Machine& machine, uint8_t port, uint8_t value) const { outputs[port](machine, value); }
+
+private:
+    template <auto DEVICE, auto READ>
+    static uint8_t ReadDevice(Machine& machine) { return ((machine.*DEVICE).*READ)(); }
+
+    template <auto DEVICE, auto WRITE>
+    static void WriteDevice(Machine& machine, uint8_t value) { ((machine.*DEVICE).*WRITE)(value); }
+
+    template <uint8_t Machine::*LATCH>
+    static uint8_t ReadLatch(Machine& machine) { return machine.*LATCH; }
+
+    static uint8_t OpenBus(Machine&) { return 0; }
+    static void Ignore(Machine&, uint8_t) {}
+
+    InputHandler inputs[256];
+    OutputHandler outputs[256];
+};
+
+#endif
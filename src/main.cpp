@@ -1,92 +1,293 @@
 #include "cpu.h"
+#include <chrono>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
 #include <iostream>
+#include <string>
+#include <thread>
+#include "audio.h"
+#include "capture.h"
+#include "emulator.h"
 #include "graphics.h"
+#include "input.h"
+#include "screen_export.h"
 
-const int FPS = 60;
-const int frameDelay = 1000 / FPS;
+static volatile std::sig_atomic_t interrupted = 0; // Headless: Ctrl+C stops the run cleanly
+
+static void Interrupt(int) {
+    interrupted = 1;
+}
+
+static void PrintFrameStats(Emulator& emulator, const Audio& audio, bool sound, const Capture& capture) {
+    FrameStats stats = emulator.Statistics();
+    std::cout << "Frames: " << stats.frames << " (" << stats.late << " late), frame time ms min "
+              << stats.minimum << " mean " << stats.mean << " p99 " << stats.p99 << " max " << stats.maximum << std::endl;
+    if (emulator.RunAhead() > 0) {
+        std::cout << "Run-ahead " << emulator.RunAhead() << " frames: " << emulator.RunAheadCost()
+                  << " ms extra per frame" << std::endl;
+    }
+    if (emulator.InputEvents()) {
+        std::cout << "Input: " << emulator.InputEvents() << " events, latency to the ports ms mean "
+                  << emulator.InputLatencyMean() << " max " << emulator.InputLatencyMax() << std::endl;
+    }
+    if (sound) {
+        std::cout << "Audio latency " << audio.Latency() << " ms (target " << audio.TargetLatency() << " ms), "
+                  << audio.Underruns() << " underruns, " << audio.Resyncs() << " resyncs, rate "
+                  << (emulator.RateAdjustment() >= 0 ? "+" : "") << emulator.RateAdjustment() * 100 << "%" << std::endl;
+    }
+    if (capture.Recording() || capture.Screenshots() || capture.Dropped()) {
+        std::cout << "Capture: " << capture.Captured() << " frames, " << capture.Dropped() << " dropped, "
+                  << capture.Screenshots() << " screenshots" << std::endl;
+    }
+}
 
 int main(int argc, char** argv) {
     if (argc < 5) {
-        std::cerr << "Usage: " << argv[0] << " invaders.h invaders.g invaders.f invaders.e" << std::endl;
+        std::cerr << "Usage: " << argv[0] << " invaders.h invaders.g invaders.f invaders.e [--accurate] [--hle] [--fused] [--ntsc] [--run-ahead frames] [--profile file] [--trace file] [--perf] [--no-sound] [--sounds dir] [--audio-sync] [--input-config file] [--overlay] [--scanlines] [--scale n] [--capture file.y4m|file.raw] [--screenshots dir] [--screenshot-every frames] [--shared-screen name] [--headless] [--frames n] [--turbo] [--verbose]" << std::endl;
         return 1;
     }
 
     CPU8080 cpu;
     Graphics graphics;
 
-    graphics.Initialize();
+    bool hle = false;
+    bool fused = false;
+    bool ntsc = false;
+    int runAhead = 0;
+    const char* profilePath = nullptr;
+    const char* tracePath = nullptr;
+    bool perf = false;
+    bool sound = true;
+    bool audioSync = false;
+    const char* inputConfig = nullptr;
+    std::string soundDirectory = "sounds";
+    const char* capturePath = nullptr;
+    std::string screenshotDirectory = ".";
+    uint64_t screenshotEvery = 0;
+    bool headless = false;
+    uint64_t frameLimit = 0;
+    bool turbo = false;
+    const char* sharedScreen = nullptr;
+    cpu.verbose = false;
+    for (int i = 5; i < argc; ++i) {
+        std::string option = argv[i];
+        if (option == "--accurate") {
+            cpu.idleSkipping = false; // Emulate idle loops instruction by instruction
+        } else if (option == "--hle") {
+            hle = true; // Native fast paths for known ROM routines
+        } else if (option == "--fused") {
+            fused = true; // Superinstruction dispatch
+        } else if (option == "--ntsc") {
+            ntsc = true; // Pace at 59.94 Hz instead of 60 Hz
+        } else if (option == "--run-ahead" && i + 1 < argc) {
+            runAhead = std::atoi(argv[++i]); // Frames to emulate ahead of the displayed one
+        } else if (option == "--profile" && i + 1 < argc) {
+            profilePath = argv[++i]; // Profile report, folded stacks go to <file>.folded
+        } else if (option == "--trace" && i + 1 < argc) {
+            tracePath = argv[++i]; // One disassembled line per instruction, large: about 150 MB per emulated second
+        } else if (option == "--perf") {
+            perf = true; // Host hardware counters around each emulated frame
+        } else if (option == "--no-sound") {
+            sound = false;
+        } else if (option == "--sounds" && i + 1 < argc) {
+            soundDirectory = argv[++i]; // Directory with the .wav samples
+        } else if (option == "--audio-sync") {
+            audioSync = true; // Pace frames by the audio clock instead of the system clock
+        } else if (option == "--input-config" && i + 1 < argc) {
+            inputConfig = argv[++i]; // Key, button and DIP switch settings (see input.h)
+        } else if (option == "--overlay") {
+            graphics.SetOverlay(true); // Colour bands of the cabinet's gel strips (F2 toggles)
+        } else if (option == "--scanlines") {
+            graphics.SetScanlines(true); // Dark gaps between raster lines, from --scale 2 up (F3 toggles)
+        } else if (option == "--scale" && i + 1 < argc) {
+            graphics.SetScale(std::atoi(argv[++i])); // Texture pixels per screen pixel, 1 to 4 (F4 cycles)
+        } else if (option == "--capture" && i + 1 < argc) {
+            capturePath = argv[++i]; // Video of every frame, .y4m or .raw (see capture.h)
+        } else if (option == "--screenshots" && i + 1 < argc) {
+            screenshotDirectory = argv[++i]; // Where F12 and --screenshot-every write PNGs
+        } else if (option == "--screenshot-every" && i + 1 < argc) {
+            screenshotEvery = std::strtoull(argv[++i], nullptr, 10);
+        } else if (option == "--shared-screen" && i + 1 < argc) {
+            sharedScreen = argv[++i]; // POSIX shared memory name for other processes, e.g. /space_invaders (see shared_screen.h)
+        } else if (option == "--headless") {
+            headless = true; // No window, sound or input devices
+        } else if (option == "--frames" && i + 1 < argc) {
+            frameLimit = std::strtoull(argv[++i], nullptr, 10); // Quit after this many frames
+        } else if (option == "--turbo") {
+            turbo = true; // Start in fast-forward (Tab toggles)
+        } else if (option == "--verbose") {
+            cpu.verbose = true;
+        } else {
+            std::cerr << "Unknown option: " << option << std::endl;
+            return 1;
+        }
+    }
+
+    if (!headless) graphics.Initialize();
+    Audio audio; // Closed before Graphics shuts SDL down
+    sound = sound && !headless && audio.Initialize(soundDirectory);
+    if (sound) {
+        cpu.soundEvents = audio.Events();
+    } else if (audioSync) {
+        std::cerr << "Warning: --audio-sync needs sound, pacing with the system clock" << std::endl;
+        audioSync = false;
+    }
     cpu.LoadProgram(argv[1], argv[2], argv[3], argv[4]);
 
-    bool running = true;
+    Input input;
+    if (!headless) input.Initialize();
+    if (inputConfig) {
+        input.LoadConfig(inputConfig);
+    }
+    cpu.port1 = input.InitialPort1();
+    cpu.port2 = input.InitialPort2();
+    if (hle) {
+        cpu.EnableHle(true);
+    }
+    cpu.EnableSuperinstructions(fused);
+
+#ifdef I8080_PROFILER
+    Profiler profiler;
+    if (profilePath) {
+        cpu.profiler = &profiler;
+    }
+#else
+    if (profilePath) {
+        std::cerr << "Error: --profile needs a build with the profiler (make PROFILE=1)" << std::endl;
+        return 1;
+    }
+#endif
 
-    Uint32 frameStart;
-    int frameTime;
+    std::ofstream trace;
+    if (tracePath) {
+        trace.open(tracePath);
+        if (!trace.is_open()) {
+            std::cerr << "Error: Could not open file " << tracePath << std::endl;
+            return 1;
+        }
+        cpu.trace = &trace;
+    }
+
+    Emulator emulator(cpu);
+    if (ntsc) {
+        emulator.SetFrameRate(60000, 1001);
+    }
+    emulator.SetDisplayRate(headless ? 60 : graphics.RefreshRate());
+    emulator.SetRunAhead(runAhead);
+    if (sound) {
+        emulator.SetAudio(&audio, audioSync);
+    }
+    PerfCounters counters;
+    if (perf) {
+        emulator.SetPerfCounters(&counters);
+    }
 
-    while(running) {
-        frameStart = SDL_GetTicks(); // Get the current time
-        std::cout << "Emulating cycle, frame start: "<< frameStart << std::endl;
+    Capture capture;
+    if (capturePath) {
+        capture.OpenVideo(capturePath, ntsc ? 60000 : 60, ntsc ? 1001 : 1);
+    }
+    capture.SetScreenshots(screenshotDirectory, screenshotEvery);
+    capture.Start();
+    emulator.SetCapture(&capture);
+    ScreenExport screenExport; // Outlives the emulation thread
+    if (sharedScreen) {
+        screenExport.Open(sharedScreen);
+        emulator.SetScreenExport(&screenExport);
+        std::cout << "Exporting the screen to shared memory " << sharedScreen << std::endl;
+    }
+    emulator.SetFrameLimit(frameLimit);
+    emulator.SetTurbo(turbo);
+    emulator.Start();
 
-        cpu.EmulateCycle();
+    if (headless) {
+        std::signal(SIGINT, Interrupt);
+        while (emulator.Running() && !interrupted) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+    }
 
-        // Render graphics
-        cpu.RenderGraphics(graphics);
+    bool running = true;
+    Uint32 titleUpdate = 0;
+    uint64_t convertedFrame = 0; // Frame whose first lines are already in the texture (no complete frame is number 0)
 
-        // Handle events keys
+    while(running && !headless && emulator.Running()) {
+        // Every pending event, drained once: bound inputs go to the emulator, the rest are hotkeys
         SDL_Event event;
         while(SDL_PollEvent(&event)) {
             if (event.type == SDL_QUIT) {
                 running = false;
-            }
-
-            // input keyboard
-            if (event.type == SDL_KEYDOWN) {
+            } else if (input.Handle(event, emulator)) {
+                continue;
+            } else if (event.type == SDL_KEYDOWN && !event.key.repeat) {
                 switch (event.key.keysym.sym) {
-                    case SDLK_LEFT:
-                        cpu.port1 |= (1 << 4); // move left
+                    case SDLK_TAB:
+                        emulator.SetTurbo(!emulator.Turbo()); // Fast-forward on/off
+                        if (!emulator.Turbo()) graphics.SetTitle("Space Invaders");
                         break;
-                    case SDLK_RIGHT:
-                        cpu.port1 |= (1 << 5); // move right
+                    case SDLK_F1:
+                        PrintFrameStats(emulator, audio, sound, capture);
                         break;
-                    case SDLK_SPACE:
-                        cpu.port1 |= (1 << 2); // fire
+                    case SDLK_F2:
+                        graphics.SetOverlay(!graphics.Filter().Overlay());
+                        convertedFrame = 0; // Convert the next frame whole with the new settings
                         break;
-                    case SDLK_RETURN:
-                        cpu.port1 |= (1 << 1); // start 1 player
+                    case SDLK_F3:
+                        graphics.SetScanlines(!graphics.Filter().Scanlines());
+                        convertedFrame = 0;
                         break;
-                }
-            }
-
-            if (event.type == SDL_KEYUP) {
-                switch (event.key.keysym.sym) {
-                    case SDLK_LEFT:
-                        cpu.port1 &= ~(1 << 4); // stop move left
-                        break;
-                    case SDLK_RIGHT:
-                        cpu.port1 &= ~(1 << 5); // stop move right
+                    case SDLK_F4:
+                        graphics.SetScale(graphics.Filter().Scale() % DisplayFilter::MAX_SCALE + 1);
+                        convertedFrame = 0;
                         break;
-                    case SDLK_SPACE:
-                        cpu.port1 &= ~(1 << 2); // stop fire
-                        break;
-                    case SDLK_RETURN:
-                        cpu.port1 &= ~(1 << 1); // stop start 1 player
+                    case SDLK_F12:
+                        capture.RequestScreenshot();
                         break;
                 }
             }
         }
 
-        // Handle events
-        graphics.HandleEvents(running);
+        // Show the achieved fast-forward speed twice a second
+        if (emulator.Turbo() && SDL_GetTicks() - titleUpdate >= 500) {
+            titleUpdate = SDL_GetTicks();
+            char title[64];
+            snprintf(title, sizeof(title), "Space Invaders - turbo x%.1f", emulator.Speed());
+            graphics.SetTitle(title);
+        }
 
-        // Print CPU state
-        cpu.PrintState();
-        // std::cin.get(); // Pause after each cycle for debugging
+        // Convert lines as soon as they are final and present complete frames; the renderer waits for vsync
+        const VideoFrame* frame = emulator.LatestFrame();
+        if (frame) {
+            int first = frame->number == convertedFrame ? VideoFrame::MID_SCREEN_LINE : 0;
+            graphics.UpdateLines(frame->vram, first, frame->lines - first);
+            if (frame->lines == VideoFrame::LINES) {
+                graphics.Present();
+            } else {
+                convertedFrame = frame->number;
+            }
+        } else {
+            SDL_Delay(1);
+        }
+    }
 
-        frameTime = SDL_GetTicks() - frameStart; // Get the time it took to render the frame
+    emulator.Stop();
+    capture.Stop();
+    audio.Close();
+    PrintFrameStats(emulator, audio, sound, capture);
+    if (perf) {
+        counters.Report(std::cout);
+    }
 
-        if (frameDelay > frameTime) {
-            SDL_Delay(frameDelay - frameTime); // Delay the frame if we are too fast
-        }
+#ifdef I8080_PROFILER
+    if (profilePath) {
+        std::ofstream report(profilePath);
+        profiler.Report(report, 30);
+        std::ofstream folded(std::string(profilePath) + ".folded");
+        profiler.WriteFoldedStacks(folded);
+        std::cout << "Profile written to " << profilePath << " and " << profilePath << ".folded" << std::endl;
     }
+#endif
 
     return 0;
-}
\ No newline at end of file
+}
@@ -0,0 +1,94 @@
+#include "memory.h"
+#include <cstring>
+
+const std::shared_ptr<Memory::Page>& Memory::ZeroPage() {
+    static const std::shared_ptr<Page> zero = std::make_shared<Page>(Page());
+    return zero;
+}
+
+Memory::Memory() : writes(0) {
+    Clear();
+}
+
+Memory::Memory(const Memory& other) {
+    *this = other;
+}
+
+Memory& Memory::operator=(const Memory& other) {
+    if (this == &other) return *this;
+
+    for (int i = 0; i < PAGE_COUNT; ++i) {
+        pages[i] = other.pages[i];
+        readPages[i] = other.readPages[i];
+        writePages[i] = nullptr;
+        other.writePages[i] = nullptr; // The source must copy before writing too
+    }
+    readOnly = other.readOnly;
+    writes = other.writes;
+    return *this;
+}
+
+void Memory::Clear() {
+    for (int i = 0; i < PAGE_COUNT; ++i) {
+        pages[i] = ZeroPage();
+        readPages[i] = pages[i]->data;
+        writePages[i] = nullptr;
+    }
+    readOnly = 0;
+}
+
+void Memory::SetReadOnly(uint16_t address, size_t size) {
+    for (uint32_t current = address; current < (uint32_t)address + size && current <= 0xFFFF; current += PAGE_SIZE) {
+        int page = current >> PAGE_BITS;
+        readOnly |= 1ull << page;
+        writePages[page] = nullptr;
+    }
+}
+
+uint8_t* Memory::Unshare(int page) {
+    if (pages[page].use_count() != 1) {
+        pages[page] = std::make_shared<Page>(*pages[page]);
+        readPages[page] = pages[page]->data;
+    }
+    writePages[page] = ((readOnly >> page) & 1) ? discard : pages[page]->data;
+    return writePages[page];
+}
+
+void Memory::Load(uint16_t address, const uint8_t* data, size_t size) {
+    size_t offset = 0;
+    while (offset < size) {
+        uint32_t current = address + offset;
+        if (current > 0xFFFF) break;
+        int page = current >> PAGE_BITS;
+        size_t chunk = PAGE_SIZE - (current & PAGE_MASK);
+        if (chunk > size - offset) chunk = size - offset;
+
+        Unshare(page);
+        uint8_t* destination = pages[page]->data; // Bypasses the read-only protection
+        std::memcpy(destination + (current & PAGE_MASK), data + offset, chunk);
+        offset += chunk;
+    }
+    writes++;
+}
+
+void Memory::CopyOut(uint16_t address, uint8_t* data, size_t size) const {
+    size_t offset = 0;
+    while (offset < size) {
+        uint32_t current = address + offset;
+        if (current > 0xFFFF) break;
+        int page = current >> PAGE_BITS;
+        size_t chunk = PAGE_SIZE - (current & PAGE_MASK);
+        if (chunk > size - offset) chunk = size - offset;
+
+        std::memcpy(data + offset, readPages[page] + (current & PAGE_MASK), chunk);
+        offset += chunk;
+    }
+}
+
+int Memory::SharedPages() const {
+    int shared = 0;
+    for (int i = 0; i < PAGE_COUNT; ++i) {
+        if (pages[i].use_count() > 1) shared++;
+    }
+    return shared;
+}
@@ -0,0 +1,61 @@
+#ifndef MEMORY_H
+#define MEMORY_H
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+// 64KB address space split in pages. Copies share their pages copy-on-write,
+// so forking a machine only duplicates the pages that are written afterwards.
+class Memory {
+public:
+    static const int PAGE_BITS = 10;
+    static const int PAGE_SIZE = 1 << PAGE_BITS; // 1KB pages
+    static const int PAGE_MASK = PAGE_SIZE - 1;
+    static const int PAGE_COUNT = 0x10000 / PAGE_SIZE;
+
+    Memory(); // All pages start as a shared zero page
+    Memory(const Memory& other); // Shares every page of other copy-on-write
+    Memory& operator=(const Memory& other);
+
+    uint8_t Read(uint16_t address) const {
+        return readPages[address >> PAGE_BITS][address & PAGE_MASK];
+    }
+
+    void Write(uint16_t address, uint8_t value) {
+        uint8_t* page = writePages[address >> PAGE_BITS];
+        if (!page) page = Unshare(address >> PAGE_BITS);
+        page[address & PAGE_MASK] = value;
+        writes++;
+    }
+
+    uint32_t WriteCount() const { return writes; } // Writes since creation, wraps around
+
+    void Clear(); // Zero the whole address space, all pages writable
+    void SetReadOnly(uint16_t address, size_t size); // Ignore CPU writes to these pages (ROM)
+    bool IsReadOnly(uint16_t address) const { return (readOnly >> (address >> PAGE_BITS)) & 1; }
+    void Load(uint16_t address, const uint8_t* data, size_t size); // Copy a block into memory, even into ROM
+    void CopyOut(uint16_t address, uint8_t* data, size_t size) const; // Copy a block out of memory
+
+    int SharedPages() const; // Pages currently shared with another Memory
+
+private:
+    struct Page {
+        uint8_t data[PAGE_SIZE];
+    };
+
+    static const std::shared_ptr<Page>& ZeroPage(); // Zero-filled page shared by every cleared Memory
+    uint8_t* Unshare(int page); // Make a page private to this Memory, copying it if needed
+
+    std::shared_ptr<Page> pages[PAGE_COUNT];
+    const uint8_t* readPages[PAGE_COUNT];
+    // Pages this Memory owns exclusively; nullptr means the page may be shared.
+    // Read-only pages point to discard once unshared.
+    // Mutable because copying from a Memory revokes its write access.
+    mutable uint8_t* writePages[PAGE_COUNT];
+    uint64_t readOnly; // One bit per page
+    uint8_t discard[PAGE_SIZE]; // Write target of read-only pages, one per Memory so machines on other threads never share it
+    uint32_t writes;
+};
+
+#endif
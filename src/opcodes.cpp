@@ -0,0 +1,25 @@
+#include "opcodes.h"
+#include <cstdio>
+#include "memory.h"
+
+std::string Disassemble(const Memory& memory, uint16_t address) {
+    const OpcodeInfo& info = OPCODES[memory.Read(address)];
+    uint16_t operand = memory.Read(address + 1) | (memory.Read(address + 2) << 8);
+
+    std::string text;
+    for (const char* c = info.mnemonic; *c; ++c) {
+        if (c[0] == '%' && (c[1] == 'b' || c[1] == 'w')) {
+            char value[8];
+            if (c[1] == 'b') {
+                std::snprintf(value, sizeof(value), "$%02X", operand & 0xFF);
+            } else {
+                std::snprintf(value, sizeof(value), "$%04X", operand);
+            }
+            text += value;
+            ++c;
+        } else {
+            text += *c;
+        }
+    }
+    return text;
+}
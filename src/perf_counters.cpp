@@ -0,0 +1,115 @@
+#include "perf_counters.h"
+#include <cstring>
+#include <iomanip>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+static const char* COUNTER_NAMES[PerfCounters::COUNTER_COUNT] = {
+    "host cycles", "host instructions", "branch misses", "L1D read misses", "LLC misses"
+};
+
+PerfCounters::PerfCounters() : batches(0), emulatedInstructions(0) {
+    for (int& fd : fds) fd = -1;
+}
+
+PerfCounters::~PerfCounters() {
+#ifdef __linux__
+    for (int fd : fds) {
+        if (fd >= 0) close(fd);
+    }
+#endif
+}
+
+#ifdef __linux__
+static int OpenCounter(uint32_t type, uint64_t config, int group) {
+    perf_event_attr attr;
+    std::memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = type;
+    attr.config = config;
+    attr.disabled = group < 0; // Members follow the leader
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+    return (int)syscall(__NR_perf_event_open, &attr, 0, -1, group, 0); // This thread, any CPU
+}
+#endif
+
+bool PerfCounters::Open() {
+#ifdef __linux__
+    if (Available()) return true;
+
+    fds[HOST_CYCLES] = OpenCounter(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES, -1);
+    if (fds[HOST_CYCLES] < 0) return false;
+
+    int leader = fds[HOST_CYCLES];
+    fds[HOST_INSTRUCTIONS] = OpenCounter(PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS, leader);
+    fds[BRANCH_MISSES] = OpenCounter(PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES, leader);
+    fds[L1D_MISSES] = OpenCounter(PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                                  (PERF_COUNT_HW_CACHE_RESULT_MISS << 16), leader);
+    fds[LLC_MISSES] = OpenCounter(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES, leader);
+    return true;
+#else
+    return false;
+#endif
+}
+
+void PerfCounters::Start() {
+#ifdef __linux__
+    if (Available()) ioctl(fds[HOST_CYCLES], PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+#endif
+}
+
+void PerfCounters::Stop(uint64_t instructions) {
+#ifdef __linux__
+    if (!Available()) return;
+    ioctl(fds[HOST_CYCLES], PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP);
+    batches++;
+    emulatedInstructions += instructions;
+#endif
+}
+
+uint64_t PerfCounters::Value(Counter counter) const {
+#ifdef __linux__
+    if (fds[counter] < 0) return 0;
+
+    uint64_t values[3]; // value, time enabled, time running
+    if (read(fds[counter], values, sizeof(values)) != sizeof(values) || values[2] == 0) return 0;
+
+    // Scale up when the kernel multiplexed the counter with others
+    return values[1] == values[2] ? values[0] : (uint64_t)((double)values[0] * values[1] / values[2]);
+#else
+    return 0;
+#endif
+}
+
+void PerfCounters::Report(std::ostream& out) const {
+    if (!Available()) {
+        out << "Hardware performance counters unavailable (perf_event_open: check "
+               "/proc/sys/kernel/perf_event_paranoid)" << std::endl;
+        return;
+    }
+
+    out << "Hardware counters over " << batches << " batches, " << emulatedInstructions << " emulated instructions:" << std::endl;
+    uint64_t perInstruction = emulatedInstructions ? emulatedInstructions : 1;
+    out << std::fixed << std::setprecision(3);
+    for (int i = 0; i < COUNTER_COUNT; ++i) {
+        out << "  " << std::setw(18) << std::left << COUNTER_NAMES[i] << std::right;
+        if (fds[i] < 0) {
+            out << "unavailable" << std::endl;
+            continue;
+        }
+        uint64_t value = Value((Counter)i);
+        out << std::setw(16) << value << std::setw(12) << (double)value / perInstruction << " per emulated instruction" << std::endl;
+    }
+
+    uint64_t cycles = Value(HOST_CYCLES);
+    if (fds[HOST_INSTRUCTIONS] >= 0 && cycles) {
+        out << "  IPC " << (double)Value(HOST_INSTRUCTIONS) / cycles << std::endl;
+    }
+}
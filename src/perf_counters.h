@@ -0,0 +1,41 @@
+#ifndef PERF_COUNTERS_H
+#define PERF_COUNTERS_H
+
+#include <cstdint>
+#include <ostream>
+
+// Host hardware performance counters (Linux perf_event_open) around batches of
+// emulation. Counters are per thread: call Open() on the thread that will run
+// the batches. When the kernel refuses (perf_event_paranoid, containers, other
+// platforms) Open() returns false and Start()/Stop() do nothing; counters the
+// CPU lacks are reported as unavailable and the rest still work.
+class PerfCounters {
+public:
+    enum Counter {
+        HOST_CYCLES,
+        HOST_INSTRUCTIONS,
+        BRANCH_MISSES,
+        L1D_MISSES, // L1 data cache read misses
+        LLC_MISSES, // Last-level cache misses
+        COUNTER_COUNT
+    };
+
+    PerfCounters();
+    ~PerfCounters();
+
+    bool Open(); // False if no counter could be opened
+    bool Available() const { return fds[HOST_CYCLES] >= 0; }
+
+    void Start(); // Begin a batch
+    void Stop(uint64_t emulatedInstructions); // End a batch that interpreted this many instructions
+
+    uint64_t Value(Counter counter) const; // Total over all batches, scaled for multiplexing, 0 if unavailable
+    void Report(std::ostream& out) const;
+
+private:
+    int fds[COUNTER_COUNT]; // -1 when unavailable, HOST_CYCLES is the group leader
+    uint64_t batches;
+    uint64_t emulatedInstructions;
+};
+
+#endif
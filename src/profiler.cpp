@@ -0,0 +1,226 @@
+#include "profiler.h"
+#include "opcodes.h"
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+
+// Routines of the Space Invaders ROM whose entry points are known
+static const struct { uint16_t address; const char* name; } ROM_ROUTINES[] = {
+    { 0x0000, "Reset" },
+    { 0x0008, "ScanLine96" }, // RST 1, mid-screen interrupt
+    { 0x0010, "ScanLine224" }, // RST 2, VBlank interrupt
+    { 0x0248, "RunGameObjs" },
+    { 0x08F3, "PrintMessage" },
+    { 0x08FF, "DrawChar" },
+    { 0x1400, "DrawShiftedSprite" },
+    { 0x1424, "EraseSimpleSprite" },
+    { 0x1439, "DrawSimpSprite" },
+    { 0x1452, "EraseShifted" },
+    { 0x1474, "CnvtPixNumber" },
+    { 0x14CB, "ClearSmallSprite" },
+    { 0x18D4, "Init" },
+    { 0x1A32, "BlockCopy" },
+    { 0x1A47, "ConvToScr" },
+    { 0x1A5C, "ClearScreen" },
+};
+
+// Undocumented aliases included (CALL at DD, ED, FD and RET at D9)
+static bool IsCall(uint8_t opcode) { return OPCODES[opcode].flow == FLOW_CALL; }
+static bool IsRestart(uint8_t opcode) { return OPCODES[opcode].flow == FLOW_RESTART; }
+static bool IsReturn(uint8_t opcode) { return OPCODES[opcode].flow == FLOW_RETURN; }
+
+Profiler::Profiler()
+    : clock(0), instructions(0), idleCycles(0), pcCount(0x10000, 0), pcCycles(0x10000, 0), current(ROOT) {
+    std::memset(opcodeCount, 0, sizeof(opcodeCount));
+    std::memset(opcodeCycles, 0, sizeof(opcodeCycles));
+    std::memset(interruptCount, 0, sizeof(interruptCount));
+    std::memset(interruptCycles, 0, sizeof(interruptCycles));
+    nodes.push_back({ ROOT, 0, 0 });
+
+    for (const auto& routine : ROM_ROUTINES) {
+        symbols[routine.address] = routine.name;
+    }
+}
+
+bool Profiler::LoadSymbols(const char* path) {
+    std::ifstream file(path);
+    if (!file.is_open()) return false;
+
+    std::string line;
+    while (std::getline(file, line)) {
+        std::istringstream fields(line);
+        unsigned address;
+        std::string name;
+        if (fields >> std::hex >> address >> name && address <= 0xFFFF) {
+            symbols[address] = name;
+        }
+    }
+    return true;
+}
+
+void Profiler::Instruction(const Memory& memory, uint16_t pc, uint8_t opcode, uint32_t cycles,
+                           uint16_t spBefore, uint16_t spAfter) {
+    instructions++;
+    clock += cycles;
+    opcodeCount[opcode]++;
+    opcodeCycles[opcode] += cycles;
+    pcCount[pc]++;
+    pcCycles[pc] += cycles;
+    nodes[current].cycles += cycles;
+
+    // Only taken calls and returns move the stack pointer
+    if (IsCall(opcode) && spAfter == (uint16_t)(spBefore - 2)) {
+        Enter(memory.Read(pc + 1) | (memory.Read(pc + 2) << 8), spAfter, -1);
+    } else if (IsRestart(opcode)) {
+        Enter(opcode & 0x38, spAfter, -1);
+    } else if (IsReturn(opcode) && spAfter == (uint16_t)(spBefore + 2)) {
+        Unwind(spAfter);
+    }
+}
+
+void Profiler::Interrupt(int number, uint16_t sp) {
+    Enter(number * 8, sp, number);
+}
+
+void Profiler::Idle(uint64_t cycles) {
+    clock += cycles;
+    idleCycles += cycles;
+}
+
+void Profiler::Enter(uint16_t address, uint16_t sp, int interrupt) {
+    // Frames at or below the new return address were abandoned (stack reset, POP of a return address)
+    Unwind((uint32_t)sp + 1);
+
+    if (interrupt < 0 && !symbols.count(address)) {
+        std::ostringstream name;
+        name << "sub_" << std::hex << std::uppercase << std::setw(4) << std::setfill('0') << address;
+        symbols[address] = name.str();
+    }
+
+    current = Child(current, address);
+    frames.push_back({ sp, current, clock, interrupt });
+}
+
+void Profiler::Unwind(uint32_t sp) {
+    while (!frames.empty() && frames.back().sp < sp) {
+        const Frame& frame = frames.back();
+        if (frame.interrupt >= 0) {
+            interruptCount[frame.interrupt]++;
+            interruptCycles[frame.interrupt] += clock - frame.entry;
+        }
+        frames.pop_back();
+    }
+    current = frames.empty() ? ROOT : frames.back().node;
+}
+
+int Profiler::Child(int parent, uint16_t address) {
+    uint32_t key = ((uint32_t)parent << 16) | address;
+    auto found = children.find(key);
+    if (found != children.end()) return found->second;
+
+    nodes.push_back({ parent, address, 0 });
+    children[key] = (int)nodes.size() - 1;
+    return (int)nodes.size() - 1;
+}
+
+std::string Profiler::RoutineName(uint16_t address) const {
+    auto routine = symbols.upper_bound(address);
+    if (routine == symbols.begin()) return "?";
+    --routine;
+
+    std::ostringstream name;
+    name << routine->second;
+    if (address != routine->first) name << "+0x" << std::hex << address - routine->first;
+    return name.str();
+}
+
+static double Percent(uint64_t part, uint64_t total) {
+    return total ? 100.0 * part / total : 0.0;
+}
+
+// Mnemonic with placeholder operands, e.g. "MVI B,n" or "JNZ nn"
+static std::string GenericMnemonic(int opcode) {
+    std::string text = OPCODES[opcode].mnemonic;
+    size_t operand = text.find('%');
+    if (operand != std::string::npos) text.replace(operand, 2, text[operand + 1] == 'w' ? "nn" : "n");
+    return text;
+}
+
+void Profiler::Report(std::ostream& out, int top) const {
+    uint64_t executed = clock - idleCycles;
+    out << std::fixed << std::setprecision(2);
+    out << "Instructions: " << instructions << ", cycles: " << clock << " (" << idleCycles << " idle, "
+        << Percent(idleCycles, clock) << "%)" << std::endl;
+
+    // Opcodes by cycles
+    std::vector<std::pair<uint64_t, int>> opcodes;
+    for (int i = 0; i < 256; ++i) {
+        if (opcodeCount[i]) opcodes.push_back(std::make_pair(opcodeCycles[i], i));
+    }
+    std::sort(opcodes.begin(), opcodes.end(), std::greater<std::pair<uint64_t, int>>());
+    out << "Opcodes by cycles:" << std::endl;
+    for (int i = 0; i < top && i < (int)opcodes.size(); ++i) {
+        int opcode = opcodes[i].second;
+        out << "  " << std::hex << std::setw(2) << std::setfill('0') << opcode << std::dec << std::setfill(' ')
+            << std::setw(14) << opcodeCount[opcode] << std::setw(14) << opcodeCycles[opcode]
+            << std::setw(8) << Percent(opcodeCycles[opcode], executed) << "%  " << GenericMnemonic(opcode) << std::endl;
+    }
+
+    // Hot addresses and the routines they belong to
+    std::vector<std::pair<uint64_t, int>> addresses;
+    std::map<std::string, uint64_t> routines;
+    for (int pc = 0; pc < 0x10000; ++pc) {
+        if (!pcCount[pc]) continue;
+        addresses.push_back(std::make_pair(pcCycles[pc], pc));
+        std::string name = RoutineName(pc);
+        routines[name.substr(0, name.find('+'))] += pcCycles[pc];
+    }
+    std::sort(addresses.begin(), addresses.end(), std::greater<std::pair<uint64_t, int>>());
+    out << "Hot addresses:" << std::endl;
+    for (int i = 0; i < top && i < (int)addresses.size(); ++i) {
+        int pc = addresses[i].second;
+        out << "  " << std::hex << std::setw(4) << std::setfill('0') << pc << std::dec << std::setfill(' ')
+            << std::setw(14) << pcCount[pc] << std::setw(14) << pcCycles[pc]
+            << std::setw(8) << Percent(pcCycles[pc], executed) << "%  " << RoutineName(pc) << std::endl;
+    }
+
+    std::vector<std::pair<uint64_t, std::string>> byRoutine;
+    for (const auto& routine : routines) {
+        byRoutine.push_back(std::make_pair(routine.second, routine.first));
+    }
+    std::sort(byRoutine.begin(), byRoutine.end(), std::greater<std::pair<uint64_t, std::string>>());
+    out << "Routines by cycles (callees excluded):" << std::endl;
+    for (int i = 0; i < top && i < (int)byRoutine.size(); ++i) {
+        out << "  " << std::setw(14) << byRoutine[i].first << std::setw(8) << Percent(byRoutine[i].first, executed)
+            << "%  " << byRoutine[i].second << std::endl;
+    }
+
+    out << "Interrupt handlers (callees included):" << std::endl;
+    for (int i = 0; i < INTERRUPT_COUNT; ++i) {
+        if (!interruptCount[i]) continue;
+        out << "  RST " << i << std::setw(12) << interruptCount[i] << " calls" << std::setw(14) << interruptCycles[i]
+            << " cycles" << std::setw(10) << (double)interruptCycles[i] / interruptCount[i] << " per call"
+            << std::setw(8) << Percent(interruptCycles[i], clock) << "%" << std::endl;
+    }
+}
+
+void Profiler::WriteFoldedStacks(std::ostream& out) const {
+    for (size_t i = 0; i < nodes.size(); ++i) {
+        if (!nodes[i].cycles) continue;
+
+        std::vector<std::string> path;
+        for (int node = (int)i; node != ROOT; node = nodes[node].parent) {
+            path.push_back(RoutineName(nodes[node].address));
+        }
+        out << "main";
+        for (auto name = path.rbegin(); name != path.rend(); ++name) {
+            out << ";" << *name;
+        }
+        out << " " << nodes[i].cycles << std::endl;
+    }
+    if (idleCycles) {
+        out << "main;[idle] " << idleCycles << std::endl;
+    }
+}
@@ -0,0 +1,85 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <cstdint>
+#include <map>
+#include <ostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "memory.h"
+
+// Execution profiler for CPU8080, built only with -DI8080_PROFILER (make PROFILE=1).
+// Without the define the hooks in the CPU expand to nothing.
+//
+// Counts executions and cycles per opcode and per PC, reconstructs the call
+// stack from CALL/RST/RET and interrupts, and charges cycles to it. The report
+// maps hot addresses to ROM routines (built-in names, a symbol file, or the
+// CALL targets seen while running); the folded stacks can be fed to
+// flamegraph.pl.
+class Profiler {
+public:
+    Profiler();
+
+    // Symbol file: one "address name" pair per line, address in hex
+    bool LoadSymbols(const char* path);
+
+    // CPU hooks
+    void Instruction(const Memory& memory, uint16_t pc, uint8_t opcode, uint32_t cycles, uint16_t spBefore, uint16_t spAfter);
+    void Interrupt(int number, uint16_t sp); // After the return address was pushed
+    void Idle(uint64_t cycles); // Cycles skipped while halted or in an idle loop
+
+    void Report(std::ostream& out, int top) const;
+    void WriteFoldedStacks(std::ostream& out) const;
+
+private:
+    static const int ROOT = 0; // Call tree node of code outside any routine
+    static const int INTERRUPT_COUNT = 8;
+
+    struct Node {
+        int parent;
+        uint16_t address; // Routine entry point
+        uint64_t cycles; // Cycles spent in this routine with this call stack, callees excluded
+    };
+
+    struct Frame {
+        uint16_t sp; // Where the return address was pushed
+        int node;
+        uint64_t entry; // Clock at entry
+        int interrupt; // RST number for interrupt handlers, -1 for calls
+    };
+
+    void Enter(uint16_t address, uint16_t sp, int interrupt);
+    void Unwind(uint32_t sp); // Drop the frames whose return address lies below sp
+    int Child(int parent, uint16_t address);
+    std::string RoutineName(uint16_t address) const; // Name of the routine containing address
+
+    uint64_t clock; // Cycles seen, including idle ones
+    uint64_t instructions;
+    uint64_t idleCycles;
+    uint64_t opcodeCount[256], opcodeCycles[256];
+    std::vector<uint64_t> pcCount, pcCycles; // Indexed by address
+    uint64_t interruptCount[INTERRUPT_COUNT], interruptCycles[INTERRUPT_COUNT];
+
+    std::vector<Node> nodes;
+    std::unordered_map<uint32_t, int> children; // (parent << 16) | address -> node
+    std::vector<Frame> frames;
+    int current;
+
+    std::map<uint16_t, std::string> symbols; // Routine entry points, known and discovered
+};
+
+#ifdef I8080_PROFILER
+#define PROFILE_INSTRUCTION_BEGIN() uint64_t profileCycles = cycles; uint16_t profileSP = SP
+#define PROFILE_INSTRUCTION_END(pc, opcode) \
+    if (profiler) profiler->Instruction(memory, pc, opcode, (uint32_t)(cycles - profileCycles), profileSP, SP)
+#define PROFILE_INTERRUPT(number) if (profiler) profiler->Interrupt(number, SP)
+#define PROFILE_IDLE(skipped) if (profiler) profiler->Idle(skipped)
+#else
+#define PROFILE_INSTRUCTION_BEGIN()
+#define PROFILE_INSTRUCTION_END(pc, opcode)
+#define PROFILE_INTERRUPT(number)
+#define PROFILE_IDLE(skipped)
+#endif
+
+#endif
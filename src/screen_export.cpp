@@ -0,0 +1,93 @@
+#include "screen_export.h"
+#include <cerrno>
+#include <cstddef>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+static_assert(sizeof(shared_screen_slot) == 64 + SHARED_SCREEN_VRAM_SIZE, "shared_screen_slot layout");
+static_assert(sizeof(shared_screen) == 64 + SHARED_SCREEN_SLOTS * sizeof(shared_screen_slot), "shared_screen layout");
+static_assert(offsetof(shared_screen_slot, vram) % 64 == 0, "VRAM starts a cache line");
+
+static const uint16_t RAM_CREDITS = 0x20EB;
+static const uint16_t RAM_HI_SCORE = 0x20F4;
+static const uint16_t RAM_P1_SCORE = 0x20F8;
+static const uint16_t RAM_P2_SCORE = 0x20FC;
+
+ScreenExport::ScreenExport() : screen(nullptr) {
+}
+
+ScreenExport::~ScreenExport() {
+    Close();
+}
+
+#if defined(__unix__) || defined(__APPLE__)
+void ScreenExport::Open(const std::string& segmentName) {
+    // Never take over an existing segment: readers may still be following another emulator through it
+    int fd = shm_open(segmentName.c_str(), O_CREAT | O_EXCL | O_RDWR, 0644);
+    if (fd < 0 && errno == EEXIST) {
+        std::cerr << "Error: Shared memory " << segmentName << " already exists (another emulator is exporting to it, "
+                  << "or a crashed run left it: remove it from /dev/shm or choose another name)" << std::endl;
+        exit(1);
+    }
+    if (fd < 0 || ftruncate(fd, sizeof(shared_screen)) != 0) {
+        std::cerr << "Error: Could not create shared memory " << segmentName << ": " << std::strerror(errno) << std::endl;
+        if (fd >= 0) shm_unlink(segmentName.c_str()); // Created above, so it is ours to remove
+        exit(1);
+    }
+    void* memory = mmap(nullptr, sizeof(shared_screen), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (memory == MAP_FAILED) {
+        std::cerr << "Error: Could not map shared memory " << segmentName << ": " << std::strerror(errno) << std::endl;
+        shm_unlink(segmentName.c_str());
+        exit(1);
+    }
+
+    // The segment starts zeroed; the magic goes last so that readers only see it ready
+    screen = static_cast<shared_screen*>(memory);
+    screen->version = SHARED_SCREEN_VERSION;
+    screen->slot_size = sizeof(shared_screen_slot);
+    __atomic_store_n(&screen->magic, SHARED_SCREEN_MAGIC, __ATOMIC_RELEASE);
+    name = segmentName;
+}
+
+void ScreenExport::Close() {
+    if (!screen) return;
+    munmap(screen, sizeof(shared_screen));
+    shm_unlink(name.c_str());
+    screen = nullptr;
+}
+#else
+void ScreenExport::Open(const std::string& segmentName) {
+    std::cerr << "Error: Shared memory export needs POSIX shared memory, not available for " << segmentName << std::endl;
+    exit(1);
+}
+
+void ScreenExport::Close() {
+}
+#endif
+
+void ScreenExport::Publish(uint64_t frame, const uint8_t* vram, const CPU8080& cpu) {
+    // The slot after the newest: the one readers have had longest to finish with
+    uint32_t index = (screen->latest + 1) % SHARED_SCREEN_SLOTS;
+    shared_screen_slot* slot = &screen->slots[index];
+
+    shared_screen_begin_write(slot);
+    slot->frame = frame;
+    slot->port1 = cpu.port1;
+    slot->port2 = cpu.port2;
+    slot->credits = cpu.memory.Read(RAM_CREDITS);
+    for (int i = 0; i < 2; ++i) {
+        slot->hi_score[i] = cpu.memory.Read(RAM_HI_SCORE + i);
+        slot->score1[i] = cpu.memory.Read(RAM_P1_SCORE + i);
+        slot->score2[i] = cpu.memory.Read(RAM_P2_SCORE + i);
+    }
+    std::memcpy(slot->vram, vram, SHARED_SCREEN_VRAM_SIZE);
+    shared_screen_end_write(screen, index);
+}
@@ -0,0 +1,30 @@
+#ifndef SCREEN_EXPORT_H
+#define SCREEN_EXPORT_H
+
+#include <cstdint>
+#include <string>
+#include "cpu.h"
+#include "shared_screen.h"
+
+// Publishes every finished frame and a small state header into a POSIX shared memory
+// segment (layout and reading protocol in shared_screen.h) for other processes on the
+// same host. Publishing is a seqlock write of one slot, about 7 KB copied: the
+// emulation thread never waits for readers and never takes a lock.
+class ScreenExport {
+public:
+    ScreenExport();
+    ~ScreenExport();
+
+    void Open(const std::string& name); // Create the segment, e.g. "/space_invaders"; exits if the name is taken
+    void Close(); // Unmap and remove the name; readers keep their mappings
+    bool IsOpen() const { return screen != nullptr; }
+
+    // Emulation thread: frame as in VideoFrame::number, VRAM as in VideoFrame::vram; ports and RAM read from cpu
+    void Publish(uint64_t frame, const uint8_t* vram, const CPU8080& cpu);
+
+private:
+    shared_screen* screen; // nullptr when closed
+    std::string name;
+};
+
+#endif
@@ -0,0 +1,96 @@
+#ifndef SHARED_SCREEN_H
+#define SHARED_SCREEN_H
+
+/*
+ * Layout of the shared-memory screen export (space_invaders --shared-screen name),
+ * for readers in other processes. The segment is a POSIX shared memory object: open
+ * it with shm_open(name, O_RDONLY) and mmap sizeof(shared_screen) bytes read-only.
+ *
+ * The emulator writes each finished frame, with a small state header, into one of
+ * SHARED_SCREEN_SLOTS slots in turn and then points latest at it. Every slot is
+ * guarded by a seqlock: its sequence is odd while the emulator writes it and goes up
+ * by two per frame. Readers never take a lock and the emulator never waits for them:
+ *
+ *     const shared_screen_slot* slot = &screen->slots[shared_screen_latest(screen)];
+ *     uint32_t sequence = shared_screen_begin_read(slot);
+ *     ... read slot->frame, slot->vram and so on in place ...
+ *     if (!shared_screen_end_read(slot, sequence)) ... the slot changed meanwhile: discard and retry
+ *
+ * A slot is only rewritten after the emulator has finished the frame after it, so a
+ * reader has a whole frame period to work on the newest frame in place.
+ * The helpers use the GCC/Clang __atomic builtins.
+ */
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define SHARED_SCREEN_MAGIC 0x42465349 /* "ISFB" */
+#define SHARED_SCREEN_VERSION 1 /* Bumped on incompatible layout changes */
+#define SHARED_SCREEN_SLOTS 2
+#define SHARED_SCREEN_VRAM_SIZE 0x1C00 /* VRAM 0x2400 - 0x3FFF: 224 raster lines of 32 bytes, 1 bit per pixel */
+
+typedef struct shared_screen_slot {
+    uint32_t sequence; /* Seqlock: odd while the slot is being written */
+    uint32_t reserved0;
+    uint64_t frame; /* Emulated frame number, from 1 */
+    uint8_t port1; /* Input ports as the game reads them (coin, starts, player controls, DIP switches) */
+    uint8_t port2;
+    uint8_t credits; /* BCD, RAM 0x20EB */
+    uint8_t reserved1;
+    uint8_t hi_score[2]; /* BCD, least significant byte first: RAM 0x20F4 */
+    uint8_t score1[2]; /* RAM 0x20F8 */
+    uint8_t score2[2]; /* RAM 0x20FC */
+    uint8_t reserved2[38]; /* VRAM starts at a 64-byte offset */
+    uint8_t vram[SHARED_SCREEN_VRAM_SIZE]; /* As the beam showed it: rotated, bit 0 of a line's first byte at the bottom */
+} shared_screen_slot;
+
+typedef struct shared_screen {
+    uint32_t magic; /* SHARED_SCREEN_MAGIC once the segment is ready */
+    uint32_t version;
+    uint32_t latest; /* Slot holding the newest finished frame */
+    uint32_t slot_size; /* sizeof(shared_screen_slot) */
+    uint64_t published; /* Frames published since the export started, 0 before the first */
+    uint8_t reserved[40];
+    shared_screen_slot slots[SHARED_SCREEN_SLOTS];
+} shared_screen;
+
+static inline uint32_t shared_screen_latest(const shared_screen* screen) {
+    return __atomic_load_n(&screen->latest, __ATOMIC_ACQUIRE);
+}
+
+static inline uint64_t shared_screen_published(const shared_screen* screen) {
+    return __atomic_load_n(&screen->published, __ATOMIC_ACQUIRE);
+}
+
+/* Sequence to pass to shared_screen_end_read; odd when a write is in progress */
+static inline uint32_t shared_screen_begin_read(const shared_screen_slot* slot) {
+    return __atomic_load_n(&slot->sequence, __ATOMIC_ACQUIRE);
+}
+
+/* 1 if everything read since shared_screen_begin_read is one consistent frame */
+static inline int shared_screen_end_read(const shared_screen_slot* slot, uint32_t sequence) {
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    return !(sequence & 1) && __atomic_load_n(&slot->sequence, __ATOMIC_RELAXED) == sequence;
+}
+
+/* Writer: around the update of a slot */
+static inline void shared_screen_begin_write(shared_screen_slot* slot) {
+    __atomic_store_n(&slot->sequence, slot->sequence + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE); /* Odd before any of the new data */
+}
+
+static inline void shared_screen_end_write(shared_screen* screen, uint32_t index) {
+    shared_screen_slot* slot = &screen->slots[index];
+    __atomic_store_n(&slot->sequence, slot->sequence + 1, __ATOMIC_RELEASE);
+    __atomic_store_n(&screen->latest, index, __ATOMIC_RELEASE);
+    __atomic_store_n(&screen->published, screen->published + 1, __ATOMIC_RELEASE);
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,48 @@
+#ifndef SPSC_QUEUE_H
+#define SPSC_QUEUE_H
+
+#include <atomic>
+#include <cstddef>
+
+// Bounded lock-free queue for one producer and one consumer thread.
+// CAPACITY must be a power of two.
+template <typename T, size_t CAPACITY>
+class SpscQueue {
+    static_assert((CAPACITY & (CAPACITY - 1)) == 0, "SpscQueue capacity must be a power of two");
+
+public:
+    SpscQueue() : head(0), tail(0) {
+    }
+
+    // Producer: false when the queue is full
+    bool Push(const T& item) {
+        size_t currentTail = tail.load(std::memory_order_relaxed);
+        if (currentTail - head.load(std::memory_order_acquire) == CAPACITY) return false;
+        items[currentTail & (CAPACITY - 1)] = item;
+        tail.store(currentTail + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Consumer: false when the queue is empty
+    bool Pop(T& item) {
+        size_t currentHead = head.load(std::memory_order_relaxed);
+        if (currentHead == tail.load(std::memory_order_acquire)) return false;
+        item = items[currentHead & (CAPACITY - 1)];
+        head.store(currentHead + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Consumer: next item without removing it, nullptr when empty
+    const T* Peek() const {
+        size_t currentHead = head.load(std::memory_order_relaxed);
+        if (currentHead == tail.load(std::memory_order_acquire)) return nullptr;
+        return &items[currentHead & (CAPACITY - 1)];
+    }
+
+private:
+    T items[CAPACITY];
+    alignas(64) std::atomic<size_t> head; // Next item to pop
+    alignas(64) std::atomic<size_t> tail; // Next free slot
+};
+
+#endif
@@ -0,0 +1,123 @@
+#include "superinstructions.h"
+#include "opcodes.h"
+#include <algorithm>
+#include <iomanip>
+#include <unordered_map>
+
+#define SUPERINSTRUCTION_ENTRY(name, ...) { name, (int)std::initializer_list<uint8_t>{__VA_ARGS__}.size(), { __VA_ARGS__ } },
+const Superinstruction SUPERINSTRUCTIONS[] = {
+    SUPERINSTRUCTION_LIST(SUPERINSTRUCTION_ENTRY)
+};
+#undef SUPERINSTRUCTION_ENTRY
+const int SUPERINSTRUCTION_COUNT = sizeof(SUPERINSTRUCTIONS) / sizeof(SUPERINSTRUCTIONS[0]);
+
+// Only the last instruction of a sequence may change the flow of control
+static constexpr bool FallsThrough(std::initializer_list<uint8_t> opcodes) {
+    size_t index = 0;
+    for (uint8_t opcode : opcodes) {
+        if (++index < opcodes.size() && OPCODES[opcode].flow != FLOW_NONE) return false;
+    }
+    return true;
+}
+
+#define SUPERINSTRUCTION_CHECK(name, ...) \
+    static_assert(FallsThrough({ __VA_ARGS__ }), "superinstruction " name " branches before its last instruction");
+SUPERINSTRUCTION_LIST(SUPERINSTRUCTION_CHECK)
+#undef SUPERINSTRUCTION_CHECK
+
+// Index of the longest superinstruction starting at address, or -1
+static int MatchAt(const Memory& memory, uint16_t address, uint16_t size) {
+    int best = -1;
+    for (int i = 0; i < SUPERINSTRUCTION_COUNT; ++i) {
+        const Superinstruction& candidate = SUPERINSTRUCTIONS[i];
+        if (best >= 0 && candidate.length <= SUPERINSTRUCTIONS[best].length) continue;
+
+        uint32_t pc = address;
+        bool match = true;
+        for (int j = 0; j < candidate.length && match; ++j) {
+            uint8_t opcode = memory.Read(pc);
+            // The whole sequence, operands included, must be in the read-only range
+            match = opcode == candidate.opcodes[j] && pc + OPCODES[opcode].length <= size;
+            pc += OPCODES[opcode].length;
+        }
+        if (match) best = i;
+    }
+    return best;
+}
+
+std::shared_ptr<const std::vector<uint8_t>> PredecodeSuperinstructions(const Memory& memory, uint16_t size) {
+    auto table = std::make_shared<std::vector<uint8_t>>(size, 0);
+    for (uint32_t address = 0; address < size; ++address) {
+        (*table)[address] = MatchAt(memory, address, size) + 1;
+    }
+    return table;
+}
+
+SequenceProfile::SequenceProfile() : chain(0), instructions(0), pairs(0x10000, 0) {
+}
+
+void SequenceProfile::Record(uint16_t pc, uint8_t opcode) {
+    instructions++;
+
+    // Only sequences that fall through from one instruction to the next can be fused
+    if (chain > 0 && (uint16_t)(lastPC[0] + OPCODES[lastOpcode[0]].length) == pc) {
+        pairs[(lastOpcode[0] << 8) | opcode]++;
+        if (chain > 1) {
+            triples[(lastOpcode[1] << 16) | (lastOpcode[0] << 8) | opcode]++;
+        }
+        chain = chain < 2 ? chain + 1 : 2;
+    } else {
+        chain = 1;
+    }
+
+    lastPC[1] = lastPC[0];
+    lastOpcode[1] = lastOpcode[0];
+    lastPC[0] = pc;
+    lastOpcode[0] = opcode;
+}
+
+// Name of the superinstruction that begins with the given opcodes, if any
+static const char* FusedBy(const uint8_t* opcodes, int length) {
+    for (int i = 0; i < SUPERINSTRUCTION_COUNT; ++i) {
+        const Superinstruction& candidate = SUPERINSTRUCTIONS[i];
+        if (candidate.length >= length && std::equal(opcodes, opcodes + length, candidate.opcodes)) {
+            return candidate.name;
+        }
+    }
+    return nullptr;
+}
+
+static void ReportSequences(std::ostream& out, const char* title, std::vector<std::pair<uint64_t, uint32_t>> entries,
+                            int length, uint64_t instructions, int top) {
+    std::sort(entries.begin(), entries.end(), std::greater<std::pair<uint64_t, uint32_t>>());
+    out << title << std::endl;
+    for (int i = 0; i < top && i < (int)entries.size() && entries[i].first > 0; ++i) {
+        uint8_t opcodes[3];
+        for (int j = 0; j < length; ++j) {
+            opcodes[j] = (entries[i].second >> (8 * (length - 1 - j))) & 0xFF;
+        }
+
+        out << "  " << std::setw(12) << entries[i].first << "  " << std::fixed << std::setprecision(2)
+            << std::setw(6) << 100.0 * entries[i].first / instructions << "%  ";
+        for (int j = 0; j < length; ++j) {
+            out << std::hex << std::setw(2) << std::setfill('0') << (int)opcodes[j] << std::dec << std::setfill(' ') << " ";
+        }
+        const char* fused = FusedBy(opcodes, length);
+        if (fused) out << " [" << fused << "]";
+        out << std::endl;
+    }
+}
+
+void SequenceProfile::Report(std::ostream& out, int top) const {
+    std::vector<std::pair<uint64_t, uint32_t>> pairEntries, tripleEntries;
+    for (uint32_t i = 0; i < pairs.size(); ++i) {
+        if (pairs[i]) pairEntries.push_back(std::make_pair(pairs[i], i));
+    }
+    for (const auto& entry : triples) {
+        tripleEntries.push_back(std::make_pair(entry.second, entry.first));
+    }
+
+    out << "Instructions profiled: " << instructions << std::endl;
+    ReportSequences(out, "Most frequent instruction pairs:", pairEntries, 2, instructions ? instructions : 1, top);
+    ReportSequences(out, "Most frequent instruction triples:", tripleEntries, 3, instructions ? instructions : 1, top);
+}
@@ -0,0 +1,59 @@
+#ifndef SUPERINSTRUCTIONS_H
+#define SUPERINSTRUCTIONS_H
+
+#include <cstdint>
+#include <memory>
+#include <ostream>
+#include <unordered_map>
+#include <vector>
+#include "memory.h"
+
+// Instruction sequences fused into a single handler, taken from the profile that
+// SequenceProfile reports for the Space Invaders ROM: the two polling loops that
+// wait for the interrupt routine (about a third of all instructions when idle
+// skipping is off) and the block copy and sprite drawing loops. Only the last
+// instruction of a sequence may change the flow of control, which is checked at
+// compile time against OPCODES. A sequence stays in the list only if
+// superinstruction_bench measures it faster fused than interpreted: for short
+// sequences the fused dispatch costs more than the instructions it saves. The
+// handlers are looked up in list order, so the hottest sequences come first.
+//   X(name, opcodes...)
+#define SUPERINSTRUCTION_LIST(X) \
+    X("LDA adr; DCR A; JNZ adr", 0x3A, 0x3D, 0xC2) \
+    X("LDA adr; ANA A; JNZ adr", 0x3A, 0xA7, 0xC2) \
+    X("LDAX D; MOV M,A; INX H; INX D", 0x1A, 0x77, 0x23, 0x13) \
+    X("LDAX D; ORA M; MOV M,A; INX D; INX H", 0x1A, 0xB6, 0x77, 0x13, 0x23)
+
+struct Superinstruction {
+    const char* name;
+    int length; // Number of instructions fused
+    uint8_t opcodes[5];
+};
+
+extern const Superinstruction SUPERINSTRUCTIONS[];
+extern const int SUPERINSTRUCTION_COUNT;
+
+// Pre-decoded stream of the read-only range [0, size): entry i is 1 + the index of the
+// superinstruction starting at address i, or 0 when none matches.
+std::shared_ptr<const std::vector<uint8_t>> PredecodeSuperinstructions(const Memory& memory, uint16_t size);
+
+// Counts how often straight-line sequences of two and three instructions execute
+class SequenceProfile {
+public:
+    SequenceProfile();
+
+    void Record(uint16_t pc, uint8_t opcode); // Called for every executed instruction
+    void Report(std::ostream& out, int top) const; // Most frequent sequences, fused ones marked
+
+    uint64_t Instructions() const { return instructions; }
+
+private:
+    uint16_t lastPC[2]; // PCs of the two previous instructions, most recent first
+    uint8_t lastOpcode[2];
+    int chain; // Instructions in the current straight-line run, capped at 2
+    uint64_t instructions;
+    std::vector<uint64_t> pairs; // Indexed by (first << 8) | second
+    std::unordered_map<uint32_t, uint64_t> triples; // Keyed by (first << 16) | (second << 8) | third
+};
+
+#endif
@@ -0,0 +1,44 @@
+#ifndef TRIPLE_BUFFER_H
+#define TRIPLE_BUFFER_H
+
+#include <atomic>
+#include <cstdint>
+
+// Lock-free triple buffer for one producer and one consumer thread.
+// The producer fills the back buffer and publishes it; the consumer always
+// gets the most recent published buffer. Neither side ever waits.
+template <typename T>
+class TripleBuffer {
+public:
+    TripleBuffer() : back(0), middle(1), front(2) {
+    }
+
+    // Producer: buffer to fill, stays owned by the producer until Publish()
+    T& Back() { return buffers[back]; }
+
+    // Producer: hand the back buffer over and take the previous middle one
+    void Publish() {
+        back = middle.exchange((uint8_t)(back | DIRTY), std::memory_order_acq_rel) & INDEX_MASK;
+    }
+
+    // Consumer: newest published buffer, or nullptr if nothing new since the last call
+    const T* Latest() {
+        if (!(middle.load(std::memory_order_relaxed) & DIRTY)) return nullptr;
+        front = middle.exchange(front, std::memory_order_acq_rel) & INDEX_MASK;
+        return &buffers[front];
+    }
+
+    // Consumer: buffer returned by the last successful Latest()
+    const T& Front() const { return buffers[front]; }
+
+private:
+    static const uint8_t DIRTY = 0x4; // Set when the middle buffer holds an unread publication
+    static const uint8_t INDEX_MASK = 0x3;
+
+    T buffers[3];
+    uint8_t back; // Producer only
+    std::atomic<uint8_t> middle; // Shared, index | DIRTY
+    uint8_t front; // Consumer only
+};
+
+#endif
@@ -0,0 +1,126 @@
+// Runs CP/M 8080 test programs (TST8080, CPUTEST, 8080PRE, 8080EXM...) on CPU8080
+// and checks their console output. The program is loaded at 0x0100, BDOS calls at
+// 0x0005 are served for console output (C = 2: character in E, C = 9: string at DE
+// ending in '$'), and a jump to 0x0000 (warm boot) ends the run.
+// Usage: cpm_harness [--expect text] [--quiet] program.com...
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+#include "../src/cpu.h"
+
+static const uint16_t TPA_START = 0x0100; // Where CP/M loads .COM files
+static const uint16_t BDOS_ENTRY = 0x0005;
+static const uint16_t BDOS_TOP = 0xFE00; // Top of the program area, read from 0x0006 by some tests
+static const uint64_t MAX_INSTRUCTIONS = 100000000000ull;
+
+// Success message of each well-known test program; none of them prints "ERROR" when it passes
+static const struct { const char* program; const char* success; } KNOWN_TESTS[] = {
+    { "TST8080.COM", "CPU IS OPERATIONAL" },
+    { "CPUTEST.COM", "CPU TESTS OK" },
+    { "8080PRE.COM", "8080 Preliminary tests complete" },
+    { "8080EXM.COM", "Tests complete" },
+    { "8080EXER.COM", "Tests complete" },
+};
+
+struct RunResult {
+    std::string output;
+    uint64_t instructions;
+    uint64_t cycles;
+    double seconds;
+    bool finished; // Returned to CP/M before the instruction limit
+};
+
+static RunResult Run(const char* path, bool echo) {
+    static CPU8080 cpu;
+    cpu.Reset();
+    cpu.verbose = false;
+    cpu.idleSkipping = false; // No interrupts: there is nothing to skip to
+    cpu.memory.Clear();
+    cpu.LoadFile(path, TPA_START);
+
+    // 0x0000: HLT stands in for the warm boot, 0x0005: JMP BDOS_TOP, BDOS_TOP: RET
+    const uint8_t page0[] = { 0x76, 0x00, 0x00, 0x00, 0x00, 0xC3, BDOS_TOP & 0xFF, BDOS_TOP >> 8 };
+    const uint8_t ret = 0xC9;
+    cpu.memory.Load(0x0000, page0, sizeof(page0));
+    cpu.memory.Load(BDOS_TOP, &ret, 1);
+    cpu.PC = TPA_START;
+    cpu.SP = BDOS_TOP;
+
+    RunResult result = { "", 0, 0, 0, false };
+    auto start = std::chrono::steady_clock::now();
+    while (cpu.instructions < MAX_INSTRUCTIONS) {
+        if (cpu.PC == BDOS_ENTRY) {
+            std::string text;
+            if (cpu.C == 2) {
+                text = (char)cpu.E;
+            } else if (cpu.C == 9) {
+                for (uint16_t address = (cpu.D << 8) | cpu.E; cpu.memory.Read(address) != '$'; ++address) {
+                    text += (char)cpu.memory.Read(address);
+                }
+            }
+            result.output += text;
+            if (echo) std::cout << text << std::flush;
+        } else if (cpu.PC == 0x0000) {
+            result.finished = true;
+            break;
+        }
+        cpu.EmulateCycle();
+    }
+    result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    result.instructions = cpu.instructions;
+    result.cycles = cpu.cycles;
+    return result;
+}
+
+static std::string ExpectedOutput(const char* path) {
+    std::string name = path;
+    name = name.substr(name.find_last_of("/\\") + 1);
+    std::transform(name.begin(), name.end(), name.begin(), [](unsigned char c) { return std::toupper(c); });
+    for (const auto& test : KNOWN_TESTS) {
+        if (name == test.program) return test.success;
+    }
+    return "";
+}
+
+int main(int argc, char** argv) {
+    std::string expect;
+    bool quiet = false;
+    std::vector<const char*> programs;
+    for (int i = 1; i < argc; ++i) {
+        std::string option = argv[i];
+        if (option == "--expect" && i + 1 < argc) {
+            expect = argv[++i]; // Success text for programs not in KNOWN_TESTS
+        } else if (option == "--quiet") {
+            quiet = true;
+        } else {
+            programs.push_back(argv[i]);
+        }
+    }
+    if (programs.empty()) {
+        std::cerr << "Usage: " << argv[0] << " [--expect text] [--quiet] program.com..." << std::endl;
+        return 1;
+    }
+
+    int failures = 0;
+    for (const char* program : programs) {
+        std::cout << "== " << program << std::endl;
+        RunResult result = Run(program, !quiet);
+
+        std::string success = expect.empty() ? ExpectedOutput(program) : expect;
+        bool passed = result.finished && result.output.find("ERROR") == std::string::npos &&
+                      (success.empty() || result.output.find(success) != std::string::npos);
+        if (!passed) failures++;
+
+        std::cout << std::endl << (passed ? "PASS " : "FAIL ") << program;
+        if (!result.finished) std::cout << " (did not return to CP/M)";
+        if (success.empty()) std::cout << " (no expected output known, only checked for ERROR)";
+        std::cout << std::endl << "  " << result.instructions << " instructions, " << result.cycles << " cycles in "
+                  << result.seconds << " s: " << result.instructions / result.seconds / 1e6 << " million instructions/s, "
+                  << result.cycles / result.seconds / CPU8080::CLOCK_RATE << "x a 2 MHz 8080" << std::endl;
+    }
+    return failures ? 1 : 0;
+}
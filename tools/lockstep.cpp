@@ -0,0 +1,314 @@
+// Runs two back ends side by side on the same ROM and input and compares their state:
+// the reference interpreter (no idle skipping, superinstructions or HLE hooks) against a
+// candidate with the selected speedups. Both are driven frame by frame with the same
+// random input and are compared whenever their cycle counters meet, at the chosen
+// granularity:
+//   instruction  every time both machines reach the same cycle
+//   block        when the reference has just taken a branch, call, return or interrupt
+//   frame        after each interrupt
+// On a difference at block or frame granularity the span since the last match is replayed
+// at instruction granularity to find the first differing instruction, which is printed
+// together with both machine states.
+// Usage: lockstep [--fused] [--hle] [--idle] [--granularity instruction|block|frame]
+//                 [--frames N] [--seed N] [--fuzz seconds] rom1 rom2 rom3 rom4
+#include <chrono>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "../src/cpu.h"
+#include "../src/opcodes.h"
+
+enum Granularity { GRANULARITY_INSTRUCTION, GRANULARITY_BLOCK, GRANULARITY_FRAME };
+
+// Port 1 inputs the random player presses; bit 3 always reads as 1
+static const uint8_t PORT1_ALWAYS_ON = 0x08;
+static const uint8_t PORT1_BUTTONS[] = { 0x01, 0x04, 0x10, 0x20, 0x40 }; // Coin, 1P start, fire, left, right
+
+struct Machine {
+    CPU8080 cpu;
+    uint16_t lastPC; // Address of the last dispatch
+    uint8_t lastOpcode;
+    uint64_t lastCycles; // Cycle counter before it
+};
+
+struct Options {
+    const char* roms[4];
+    bool fused, hle, idle;
+    Granularity granularity;
+    uint64_t frames;
+    uint64_t seed;
+    double fuzzSeconds; // 0: a single run
+};
+
+static void Boot(Machine& machine, const Options& options, bool candidate) {
+    CPU8080& cpu = machine.cpu;
+    cpu.Reset();
+    cpu.verbose = false;
+    cpu.LoadProgram(options.roms[0], options.roms[1], options.roms[2], options.roms[3]);
+    cpu.PC = 0x0000;
+    cpu.idleSkipping = candidate && options.idle;
+    if (candidate && options.hle) cpu.EnableHle(false);
+    cpu.EnableSuperinstructions(candidate && options.fused);
+    machine.lastPC = cpu.PC;
+    machine.lastOpcode = 0;
+    machine.lastCycles = 0;
+}
+
+static std::string Hex(unsigned value, int digits) {
+    std::ostringstream out;
+    out << std::hex << std::uppercase << std::setw(digits) << std::setfill('0') << value;
+    return out.str();
+}
+
+// Differences between the two machines, empty when they match. Memory is compared
+// only when compareMemory is set.
+static std::string Compare(const CPU8080& a, const CPU8080& b, bool compareMemory) {
+    CPUSnapshot x, y;
+    a.SaveState(x);
+    b.SaveState(y);
+
+    std::ostringstream out;
+    auto field = [&](const char* name, unsigned p, unsigned q, int digits) {
+        if (p != q) out << " " << name << " " << Hex(p, digits) << "/" << Hex(q, digits);
+    };
+    field("A", x.A, y.A, 2); field("B", x.B, y.B, 2); field("C", x.C, y.C, 2); field("D", x.D, y.D, 2);
+    field("E", x.E, y.E, 2); field("H", x.H, y.H, 2); field("L", x.L, y.L, 2);
+    field("F", x.flags, y.flags, 2); field("SP", x.SP, y.SP, 4); field("PC", x.PC, y.PC, 4);
+    field("shift", x.shifter.value, y.shifter.value, 4); field("offset", x.shifter.offset, y.shifter.offset, 1);
+    field("sound1", x.sound.bank1, y.sound.bank1, 2); field("sound2", x.sound.bank2, y.sound.bank2, 2);
+    field("IE", x.interruptsEnabled, y.interruptsEnabled, 1); field("halt", x.halted, y.halted, 1);
+    if (x.cycles != y.cycles) out << " cycles " << x.cycles << "/" << y.cycles;
+
+    if (compareMemory) {
+        static uint8_t memoryA[0x10000], memoryB[0x10000];
+        x.memory.CopyOut(0x0000, memoryA, sizeof(memoryA));
+        y.memory.CopyOut(0x0000, memoryB, sizeof(memoryB));
+        int shown = 0, differing = 0;
+        for (int address = 0; address < 0x10000; ++address) {
+            if (memoryA[address] == memoryB[address]) continue;
+            if (shown++ < 8) {
+                out << " [" << Hex(address, 4) << "] " << Hex(memoryA[address], 2) << "/" << Hex(memoryB[address], 2);
+            }
+            differing++;
+        }
+        if (differing > shown) out << " (" << differing << " bytes differ)";
+    }
+    return out.str();
+}
+
+static void PrintState(const char* name, const Machine& machine) {
+    const CPU8080& cpu = machine.cpu;
+    std::cout << "  " << std::left << std::setw(10) << name << std::right
+              << " last " << Hex(machine.lastPC, 4) << ": " << Disassemble(cpu.memory, machine.lastPC)
+              << " at cycle " << machine.lastCycles << std::endl
+              << "             A=" << Hex(cpu.A, 2) << " BC=" << Hex(cpu.B, 2) << Hex(cpu.C, 2)
+              << " DE=" << Hex(cpu.D, 2) << Hex(cpu.E, 2) << " HL=" << Hex(cpu.H, 2) << Hex(cpu.L, 2)
+              << " F=" << Hex(cpu.flags, 2) << " SP=" << Hex(cpu.SP, 4) << " PC=" << Hex(cpu.PC, 4)
+              << " IE=" << cpu.interruptsEnabled << " halted=" << cpu.halted << " cycle " << cpu.cycles << std::endl;
+}
+
+class Lockstep {
+public:
+    Lockstep(const Options& options, uint64_t seed) : options(options), random(seed), port1(PORT1_ALWAYS_ON) {
+        Boot(reference, options, false);
+        Boot(candidate, options, true);
+    }
+
+    // Returns false and prints a report on the first divergence
+    bool Run(uint64_t frames) {
+        for (uint64_t frame = 0; frame < frames; ++frame) {
+            RandomInput();
+            uint64_t frameStart = reference.cpu.frames * CPU8080::CYCLES_PER_FRAME;
+            if (!RunTo(frameStart + CPU8080::CYCLES_PER_FRAME / 2, 1)) return false;
+            if (!RunTo(frameStart + CPU8080::CYCLES_PER_FRAME, 2)) return false;
+            reference.cpu.frames++;
+            candidate.cpu.frames++;
+        }
+        return true;
+    }
+
+    uint64_t Compares() const { return compares; }
+
+private:
+    void RandomInput() {
+        // Change the held buttons now and then, like a player would
+        if (random() % 8 == 0) {
+            port1 = PORT1_ALWAYS_ON;
+            for (uint8_t button : PORT1_BUTTONS) {
+                if (random() % 4 == 0) port1 |= button;
+            }
+        }
+        reference.cpu.port1 = candidate.cpu.port1 = port1;
+    }
+
+    static void Step(Machine& machine, uint64_t limit) {
+        machine.lastPC = machine.cpu.PC;
+        machine.lastOpcode = machine.cpu.memory.Read(machine.cpu.PC);
+        machine.lastCycles = machine.cpu.cycles;
+        machine.cpu.Step(limit);
+    }
+
+    // The reference's last instruction ended a basic block
+    bool BlockEnded() const {
+        return reference.cpu.PC != (uint16_t)(reference.lastPC + OPCODES[reference.lastOpcode].length);
+    }
+
+    // Advance both machines to target and raise the interrupt; compares along the way
+    bool RunTo(uint64_t target, int interrupt) {
+        Save();
+        if (!Advance(target, options.granularity)) return Bisect(target, interrupt);
+        reference.cpu.GenerateInterrupt(interrupt);
+        candidate.cpu.GenerateInterrupt(interrupt);
+        std::string difference = Compare(reference.cpu, candidate.cpu, true);
+        compares++;
+        if (difference.empty()) return true;
+        return Bisect(target, interrupt);
+    }
+
+    bool Advance(uint64_t target, Granularity granularity) {
+        uint32_t writesReference = reference.cpu.memory.WriteCount();
+        uint32_t writesCandidate = candidate.cpu.memory.WriteCount();
+
+        // Step whichever machine is behind until both reach target and meet. With interrupts
+        // disabled the candidate may run past target; the reference then catches up.
+        while (reference.cpu.cycles < target || candidate.cpu.cycles != reference.cpu.cycles) {
+            bool stepCandidate = candidate.cpu.cycles < reference.cpu.cycles ||
+                                 (candidate.cpu.cycles == reference.cpu.cycles && candidate.cpu.cycles < target);
+            Machine& behind = stepCandidate ? candidate : reference;
+            Machine& ahead = stepCandidate ? reference : candidate;
+            Step(behind, std::max(target, ahead.cpu.cycles));
+
+            if (granularity == GRANULARITY_FRAME || candidate.cpu.cycles != reference.cpu.cycles) continue;
+            if (granularity == GRANULARITY_BLOCK && !BlockEnded()) continue;
+
+            // Memory only needs comparing when either machine wrote since the last comparison
+            bool wrote = reference.cpu.memory.WriteCount() != writesReference ||
+                         candidate.cpu.memory.WriteCount() != writesCandidate;
+            writesReference = reference.cpu.memory.WriteCount();
+            writesCandidate = candidate.cpu.memory.WriteCount();
+            compares++;
+            if (!Compare(reference.cpu, candidate.cpu, wrote).empty()) return false;
+            if (granularity == GRANULARITY_BLOCK) Save();
+        }
+        return true;
+    }
+
+    // Copies share memory pages copy-on-write and keep the idle detector, so a replay is exact
+    void Save() {
+        referenceSaved = reference;
+        candidateSaved = candidate;
+    }
+
+    // Replay from the last matching state one instruction at a time and report the first difference
+    bool Bisect(uint64_t target, int interrupt) {
+        if (options.granularity != GRANULARITY_INSTRUCTION) {
+            Machine failedReference = reference, failedCandidate = candidate;
+            reference = referenceSaved;
+            candidate = candidateSaved;
+            if (Advance(target, GRANULARITY_INSTRUCTION)) {
+                // Only the interrupt itself, or the replay did not reproduce the difference
+                reference.cpu.GenerateInterrupt(interrupt);
+                candidate.cpu.GenerateInterrupt(interrupt);
+                if (!Compare(reference.cpu, candidate.cpu, true).empty()) {
+                    std::cout << "Divergence after interrupt " << interrupt << std::endl;
+                } else {
+                    std::cout << "Divergence not reproduced at instruction granularity" << std::endl;
+                    reference = failedReference;
+                    candidate = failedCandidate;
+                }
+                Report();
+                return false;
+            }
+        }
+        std::cout << "Divergence at the first differing instruction" << std::endl;
+        Report();
+        return false;
+    }
+
+    void Report() {
+        std::cout << "  frame " << reference.cpu.frames << ", reference/candidate:"
+                  << Compare(reference.cpu, candidate.cpu, true) << std::endl;
+        PrintState("reference", reference);
+        PrintState("candidate", candidate);
+    }
+
+    const Options& options;
+    std::mt19937_64 random;
+    uint8_t port1;
+    Machine reference, candidate;
+    Machine referenceSaved, candidateSaved; // Last matching state
+    uint64_t compares = 0;
+};
+
+static void Usage(const char* program) {
+    std::cerr << "Usage: " << program << " [--fused] [--hle] [--idle] [--granularity instruction|block|frame]"
+              << " [--frames N] [--seed N] [--fuzz seconds] rom1 rom2 rom3 rom4" << std::endl;
+    exit(1);
+}
+
+int main(int argc, char** argv) {
+    Options options = { {}, false, false, false, GRANULARITY_BLOCK, 3600, 1, 0 };
+    int romCount = 0;
+    for (int i = 1; i < argc; ++i) {
+        std::string option = argv[i];
+        if (option == "--fused") {
+            options.fused = true;
+        } else if (option == "--hle") {
+            options.hle = true;
+        } else if (option == "--idle") {
+            options.idle = true;
+        } else if (option == "--granularity" && i + 1 < argc) {
+            std::string value = argv[++i];
+            if (value == "instruction") options.granularity = GRANULARITY_INSTRUCTION;
+            else if (value == "block") options.granularity = GRANULARITY_BLOCK;
+            else if (value == "frame") options.granularity = GRANULARITY_FRAME;
+            else Usage(argv[0]);
+        } else if (option == "--frames" && i + 1 < argc) {
+            options.frames = std::stoull(argv[++i]);
+        } else if (option == "--seed" && i + 1 < argc) {
+            options.seed = std::stoull(argv[++i]);
+        } else if (option == "--fuzz" && i + 1 < argc) {
+            options.fuzzSeconds = std::stod(argv[++i]); // Runs with consecutive seeds until the time is up
+        } else if (romCount < 4) {
+            options.roms[romCount++] = argv[i];
+        } else {
+            Usage(argv[0]);
+        }
+    }
+    if (romCount != 4) Usage(argv[0]);
+
+    static const char* GRANULARITY_NAMES[] = { "instruction", "block", "frame" };
+    std::cout << "Reference interpreter against" << (options.fused ? " --fused" : "") << (options.hle ? " --hle" : "")
+              << (options.idle ? " --idle" : "") << (options.fused || options.hle || options.idle ? "" : " itself")
+              << ", " << GRANULARITY_NAMES[options.granularity] << " granularity, " << options.frames
+              << " frames per run" << std::endl;
+
+    auto start = std::chrono::steady_clock::now();
+    uint64_t runs = 0, frames = 0, compares = 0;
+    for (uint64_t seed = options.seed;; ++seed) {
+        std::streambuf* output = std::cout.rdbuf(nullptr); // Silence the ROM loader
+        std::unique_ptr<Lockstep> lockstep(new Lockstep(options, seed));
+        std::cout.rdbuf(output);
+
+        bool passed = lockstep->Run(options.frames);
+        compares += lockstep->Compares();
+        if (!passed) {
+            std::cout << "FAIL with --seed " << seed << std::endl;
+            return 1;
+        }
+        runs++;
+        frames += options.frames;
+
+        double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        if (elapsed >= options.fuzzSeconds) {
+            std::cout << "PASS " << runs << " runs, " << frames << " frames, " << compares << " comparisons in "
+                      << elapsed << " s" << std::endl;
+            return 0;
+        }
+    }
+}
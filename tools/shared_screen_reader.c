@@ -0,0 +1,114 @@
+/*
+ * Reads the screen that space_invaders exports with --shared-screen, from another
+ * process: follows the newest frame for a while, reporting frames seen and missed,
+ * read retries and the score once a second, then prints the last screen as text.
+ * Frames are read in place in the shared memory, without copying.
+ * Usage: shared_screen_reader [name] [seconds]   (defaults /space_invaders, 5)
+ */
+#define _POSIX_C_SOURCE 200809L
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+#include <time.h>
+#include <unistd.h>
+#include "../src/shared_screen.h"
+
+#define TEXT_COLUMNS 56 /* Each character shows 4x8 pixels of the upright 224x256 screen */
+#define TEXT_ROWS 32
+
+static double Now(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+static unsigned Bcd(const uint8_t* value) {
+    return (value[1] >> 4) * 1000 + (value[1] & 0x0F) * 100 + (value[0] >> 4) * 10 + (value[0] & 0x0F);
+}
+
+/* Text picture of the screen: a character is lit if any pixel of its block is */
+static void Render(const uint8_t* vram, char text[TEXT_ROWS][TEXT_COLUMNS + 1]) {
+    for (int row = 0; row < TEXT_ROWS; ++row) {
+        for (int column = 0; column < TEXT_COLUMNS; ++column) {
+            int lit = 0;
+            for (int x = column * 4; x < column * 4 + 4; ++x) {
+                /* Raster line x, from the bottom: the 8 pixels of this row are one byte */
+                lit |= vram[x * 32 + (TEXT_ROWS - 1 - row)];
+            }
+            text[row][column] = lit ? '#' : ' ';
+        }
+        text[row][TEXT_COLUMNS] = '\0';
+    }
+}
+
+int main(int argc, char** argv) {
+    const char* name = argc > 1 ? argv[1] : "/space_invaders";
+    double seconds = argc > 2 ? atof(argv[2]) : 5;
+
+    int fd = shm_open(name, O_RDONLY, 0);
+    if (fd < 0) {
+        fprintf(stderr, "Error: No shared screen %s (run space_invaders with --shared-screen %s)\n", name, name);
+        return 1;
+    }
+    const shared_screen* screen = mmap(NULL, sizeof(shared_screen), PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (screen == MAP_FAILED) {
+        perror("mmap");
+        return 1;
+    }
+    if (__atomic_load_n(&screen->magic, __ATOMIC_ACQUIRE) != SHARED_SCREEN_MAGIC || screen->version != SHARED_SCREEN_VERSION ||
+        screen->slot_size != sizeof(shared_screen_slot)) {
+        fprintf(stderr, "Error: %s is not a version %d shared screen\n", name, SHARED_SCREEN_VERSION);
+        return 1;
+    }
+
+    static char text[TEXT_ROWS][TEXT_COLUMNS + 1];
+    uint64_t published = 0, lastFrame = 0, seen = 0, missed = 0, retries = 0;
+    unsigned score1 = 0, hiScore = 0;
+    int rendered = 0;
+    double start = Now(), report = start + 1;
+    struct timespec poll = { 0, 1000000 };
+
+    while (Now() - start < seconds) {
+        if (shared_screen_published(screen) == published) {
+            nanosleep(&poll, NULL);
+            continue;
+        }
+        published = shared_screen_published(screen);
+
+        /* Read the newest frame in place; if the emulator rewrote the slot meanwhile, start over */
+        const shared_screen_slot* slot;
+        uint32_t sequence;
+        uint64_t frame;
+        for (;;) {
+            slot = &screen->slots[shared_screen_latest(screen)];
+            sequence = shared_screen_begin_read(slot);
+            frame = slot->frame;
+            score1 = Bcd(slot->score1);
+            hiScore = Bcd(slot->hi_score);
+            Render(slot->vram, text);
+            if (shared_screen_end_read(slot, sequence)) break;
+            retries++;
+        }
+
+        if (lastFrame && frame > lastFrame + 1) missed += frame - lastFrame - 1;
+        if (frame != lastFrame) seen++;
+        lastFrame = frame;
+        rendered = 1;
+
+        if (Now() >= report) {
+            printf("frame %llu: %llu seen, %llu missed, %llu retries, score %04u, hi-score %04u\n", (unsigned long long)frame,
+                   (unsigned long long)seen, (unsigned long long)missed, (unsigned long long)retries, score1, hiScore);
+            report += 1;
+        }
+    }
+
+    if (rendered) {
+        for (int row = 0; row < TEXT_ROWS; ++row) printf("|%s|\n", text[row]);
+    } else {
+        printf("No frames published in %g seconds\n", seconds);
+    }
+    munmap((void*)screen, sizeof(shared_screen));
+    return 0;
+}